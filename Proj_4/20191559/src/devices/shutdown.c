@@ -5,13 +5,24 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#endif
+#ifdef VM
+#include "vm/ksm.h"
 #endif
 
 /* Keyboard control register port. */
@@ -130,12 +141,23 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  lock_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  slab_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  cache_print_stats ();
+  inode_print_stats ();
+  free_map_print_stats ();
+  dcache_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  ksm_print_stats ();
+#endif
 }
@@ -1,5 +1,6 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <heap.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
@@ -30,7 +31,40 @@ static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-struct list sleep_list;
+/* Threads sleeping in timer_sleep(), ordered by wake_time, so
+   the timer interrupt only has to look at the top of the heap.
+   Threads with the same wake_time are ordered by sleep_seq, so
+   they wake in the order they went to sleep. */
+static struct heap sleepers;
+static uint64_t next_sleep_seq;
+
+/* Tickless idle.  If true, the idle thread stops the periodic
+   tick while no thread can run: timer_idle_enter() programs a
+   single PIT interrupt for the next sleeper's wake time, and
+   `ticks' is advanced by the whole interval when the CPU wakes.
+   Set by the "-tickless" kernel command-line option. */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot interval, in ticks, that the PIT's 16-bit
+   counter can time. */
+#define MAX_ONESHOT_TICKS (UINT16_MAX / CYCLES_PER_TICK)
+
+static int64_t oneshot_ticks;   /* Ticks in pending one-shot, or 0. */
+static long long oneshot_cnt;   /* # of tickless halts. */
+static long long skipped_ticks; /* # of ticks with no interrupt. */
+
+/* Sleeper statistics. */
+static long long wakeup_cnt;            /* # of threads woken. */
+static size_t peak_sleepers;            /* Most threads asleep at once. */
+static uint64_t max_wake_cycles;        /* Longest wakeup pass, in cycles. */
+
+static bool earlier_wake (const struct heap_elem *, const struct heap_elem *,
+                          void *aux);
+static inline uint64_t read_tsc (void);
+static void end_oneshot (void);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -39,7 +73,7 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  list_init(&sleep_list);
+  heap_init (&sleepers, earlier_wake, NULL);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -100,8 +134,10 @@ timer_sleep (int64_t ticks)
   enum intr_level old_level = intr_disable();
   struct thread *current_thread = thread_current();
   current_thread->wake_time = end_time;
-  // Add to sleep_list
-  list_push_back(&sleep_list, &current_thread->elem);
+  current_thread->sleep_seq = next_sleep_seq++;
+  // Add to the sleepers heap
+  heap_push(&sleepers, &current_thread->sleep_elem);
+  if (heap_size(&sleepers) > peak_sleepers) peak_sleepers = heap_size(&sleepers);
   thread_block();
   intr_set_level(old_level);
 }
@@ -174,23 +210,108 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %lld wakeups, peak %zu sleepers, "
+          "longest wakeup pass %"PRIu64" cycles\n",
+          wakeup_cnt, peak_sleepers, max_wake_cycles);
+  if (timer_tickless)
+    printf ("Timer: %lld tickless halts, %lld ticks skipped\n",
+            oneshot_cnt, skipped_ticks);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU because no thread can run.  In tickless mode,
+   replaces the periodic tick by one interrupt when the first
+   sleeper is due, or as late as the PIT can count.  With the
+   MLFQS or aging, the interval also ends by the next whole
+   second, so that the once-a-second load average and recent_cpu
+   updates still happen on time.  (Blocked threads' priorities
+   depend only on those, so the 4-tick updates in between can be
+   skipped.) */
+void
+timer_idle_enter (void) 
+{
+  int64_t delta = MAX_ONESHOT_TICKS;
+  struct heap_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless)
+    return;
+
+  e = heap_top (&sleepers);
+  if (e != NULL)
+    {
+      int64_t wake_time = heap_entry (e, struct thread, sleep_elem)->wake_time;
+      if (wake_time - ticks < delta)
+        delta = wake_time - ticks;
+    }
+  if ((thread_aging || thread_mlfqs) && TIMER_FREQ - ticks % TIMER_FREQ < delta)
+    delta = TIMER_FREQ - ticks % TIMER_FREQ;
+
+  /* For a single tick, the periodic interrupt does as well. */
+  if (delta < 2)
+    return;
+
+  oneshot_ticks = delta;
+  oneshot_cnt++;
+  pit_start_oneshot (0, delta * CYCLES_PER_TICK);
+}
+
+/* Called by the idle thread, with interrupts off, after a halt.
+   If an interrupt other than the timer's ended a tickless halt,
+   advances `ticks' by the whole ticks that passed, read from the
+   PIT, and goes back to periodic ticks.  The fraction of a tick
+   that had passed is lost, so the tick count falls behind real
+   time by less than one tick for each such early wakeup. */
+void
+timer_idle_exit (void) 
+{
+  int64_t elapsed;
+  uint16_t left;
+  bool expired;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  left = pit_read_counter (0, &expired);
+  if (expired)
+    {
+      /* The count ran out after interrupts were turned off.  Its
+         interrupt is pending and will count the last tick. */
+      elapsed = oneshot_ticks - 1;
+    }
+  else
+    elapsed = (oneshot_ticks * CYCLES_PER_TICK - left) / CYCLES_PER_TICK;
+  end_oneshot ();
+
+  ticks += elapsed;
+  skipped_ticks += elapsed;
 }
 
 /* Timer interrupt handler. */
 static void timer_interrupt(struct intr_frame *args UNUSED) {
+  // A tickless halt ran its full interval: count all of its ticks
+  if (oneshot_ticks > 0) {
+    ticks += oneshot_ticks - 1;
+    skipped_ticks += oneshot_ticks - 1;
+    end_oneshot();
+  }
   ticks++;
   thread_tick();
-  // Wake up sleeping threads
-  struct list_elem *e = list_begin(&sleep_list);
-  while (e != list_end(&sleep_list)) {
-      struct thread *t = list_entry(e, struct thread, elem);
-      if (t->wake_time <= ticks) {
-          e = list_remove(e);
-          thread_unblock(t);
-      } else {
-          e = list_next(e);
-      }
+  // Wake up sleeping threads: only the top of the heap can be due
+  struct heap_elem *e;
+  uint64_t start = read_tsc(), cycles;
+  while ((e = heap_top(&sleepers)) != NULL) {
+      struct thread *t = heap_entry(e, struct thread, sleep_elem);
+      if (t->wake_time > ticks) break;
+      heap_pop(&sleepers);
+      thread_unblock(t);
+      wakeup_cnt++;
   }
+  cycles = read_tsc() - start;
+  if (cycles > max_wake_cycles) max_wake_cycles = cycles;
 
   if (thread_aging || thread_mlfqs) {
     thread_current()->recent_cpu = thread_current()->recent_cpu + FRACTION;
@@ -204,6 +325,36 @@ static void timer_interrupt(struct intr_frame *args UNUSED) {
   }
 }
 
+/* Orders sleeping threads by wake_time, then by sleep_seq. */
+static bool
+earlier_wake (const struct heap_elem *a_, const struct heap_elem *b_,
+              void *aux UNUSED) 
+{
+  const struct thread *a = heap_entry (a_, struct thread, sleep_elem);
+  const struct thread *b = heap_entry (b_, struct thread, sleep_elem);
+
+  if (a->wake_time != b->wake_time)
+    return a->wake_time < b->wake_time;
+  return a->sleep_seq < b->sleep_seq;
+}
+
+/* Ends a tickless halt and restarts the periodic tick. */
+static void
+end_oneshot (void) 
+{
+  oneshot_ticks = 0;
+  pit_configure_channel (0, 2, TIMER_FREQ);
+}
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+read_tsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
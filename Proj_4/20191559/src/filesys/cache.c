@@ -0,0 +1,387 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Buffer cache.
+
+   Every sector of the file system device is read and written
+   through a cache of CACHE_SIZE sectors, so that inodes,
+   directories and the free map, which are touched on nearly
+   every operation, stay in memory.
+
+   cache_lock guards which sector each entry holds, pin counts and
+   the clock hand.  Each entry's own lock guards its data and its
+   disk I/O, so that misses on different sectors, and copies in
+   and out of different entries, proceed in parallel.  An entry
+   that some thread is using, or that is being written back, is
+   pinned and cannot be evicted, and only a pinned entry's lock
+   is ever held, so cache_lock alone suffices to read an unpinned
+   entry's dirty bit.  No disk I/O happens under cache_lock.  Lock
+   order is cache_lock, then an entry's lock.
+
+   Writes only mark an entry dirty.  A flusher thread writes
+   dirty entries back every FLUSH_INTERVAL ticks, eviction
+   writes back a dirty victim, and cache_flush() writes back
+   everything, which filesys_done() calls at shutdown.  The
+   flusher goes through filesys_sync(), so that free map changes,
+   which are kept in memory until then, reach the disk too. */
+
+/* Number of cached sectors. */
+#define CACHE_SIZE 64
+
+/* Ticks between write-behind passes. */
+#define FLUSH_INTERVAL TIMER_FREQ
+
+/* Sectors queued for read-ahead at most. */
+#define PREFETCH_QUEUE_SIZE 32
+
+/* A cached sector. */
+struct cache_entry 
+  {
+    block_sector_t sector;      /* Sector held, if VALID. */
+    bool valid;                 /* Holds a sector? */
+    bool dirty;                 /* Modified since read or written back? */
+    bool accessed;              /* Used since the clock hand passed? */
+    bool prefetched;            /* Read ahead and not used yet? */
+    int pin_cnt;                /* Threads using it; guarded by cache_lock. */
+    struct lock lock;           /* Guards DATA, DIRTY and I/O. */
+    uint8_t data[BLOCK_SECTOR_SIZE];
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static size_t clock_hand;
+
+/* Read-ahead queue, a ring buffer. */
+static block_sector_t prefetch_queue[PREFETCH_QUEUE_SIZE];
+static size_t prefetch_head;    /* Index of the oldest sector. */
+static size_t prefetch_cnt;     /* Number of sectors queued. */
+static struct lock prefetch_lock;
+static struct condition prefetch_ready;
+
+/* Statistics. */
+static long long hit_cnt;       /* # of lookups found in the cache. */
+static long long miss_cnt;      /* # of lookups that went to disk. */
+static long long writeback_cnt; /* # of dirty sectors written back. */
+static long long ahead_cnt;     /* # of sectors read ahead. */
+static long long ahead_used_cnt;    /* # of those used later. */
+static long long ahead_wasted_cnt;  /* # of those evicted unused. */
+static long long ahead_dropped_cnt; /* # not queued: queue full. */
+
+static struct cache_entry *cache_get (block_sector_t, bool whole,
+                                      bool prefetch);
+static void cache_put (struct cache_entry *);
+static struct cache_entry *lookup (block_sector_t);
+static struct cache_entry *evict (void);
+static void write_back (struct cache_entry *);
+static thread_func flusher;
+static thread_func prefetcher;
+
+/* Initializes the buffer cache and starts its flusher and
+   read-ahead threads. */
+void
+cache_init (void) 
+{
+  size_t i;
+
+  lock_init (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    lock_init (&cache[i].lock);
+  lock_init (&prefetch_lock);
+  cond_init (&prefetch_ready);
+  thread_create ("cache-flush", PRI_DEFAULT, flusher, NULL);
+  thread_create ("read-ahead", PRI_DEFAULT, prefetcher, NULL);
+}
+
+/* Copies SIZE bytes, starting SECTOR_OFS bytes into SECTOR, into
+   BUFFER. */
+void
+cache_read (block_sector_t sector, void *buffer, int sector_ofs, int size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (sector_ofs >= 0 && size >= 0);
+  ASSERT (sector_ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get (sector, false, false);
+  memcpy (buffer, e->data + sector_ofs, size);
+  cache_put (e);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR, starting SECTOR_OFS
+   bytes into it.  The sector reaches the disk later. */
+void
+cache_write (block_sector_t sector, const void *buffer,
+             int sector_ofs, int size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (sector_ofs >= 0 && size >= 0);
+  ASSERT (sector_ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get (sector, size == BLOCK_SECTOR_SIZE, false);
+  memcpy (e->data + sector_ofs, buffer, size);
+  e->dirty = true;
+  cache_put (e);
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache.
+   Does not wait.  The request is dropped if the queue is full,
+   since read-ahead is only a hint. */
+void
+cache_prefetch (block_sector_t sector) 
+{
+  lock_acquire (&prefetch_lock);
+  if (prefetch_cnt < PREFETCH_QUEUE_SIZE)
+    {
+      prefetch_queue[(prefetch_head + prefetch_cnt++)
+                     % PREFETCH_QUEUE_SIZE] = sector;
+      cond_signal (&prefetch_ready, &prefetch_lock);
+    }
+  else
+    ahead_dropped_cnt++;
+  lock_release (&prefetch_lock);
+}
+
+/* Writes every dirty sector back to disk.  Each entry is pinned
+   while it is written, so that eviction passes it by instead of
+   waiting for the write. */
+void
+cache_flush (void) 
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++) 
+    {
+      struct cache_entry *e = &cache[i];
+
+      lock_acquire (&cache_lock);
+      if (!e->valid || !e->dirty)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      write_back (e);
+      lock_release (&e->lock);
+
+      lock_acquire (&cache_lock);
+      e->pin_cnt--;
+      lock_release (&cache_lock);
+    }
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void) 
+{
+  printf ("Cache: %lld hits, %lld misses, %lld write-backs\n",
+          hit_cnt, miss_cnt, writeback_cnt);
+  printf ("Cache: %lld sectors read ahead, %lld used, %lld wasted, "
+          "%lld dropped\n",
+          ahead_cnt, ahead_used_cnt, ahead_wasted_cnt, ahead_dropped_cnt);
+}
+
+/* Returns the entry for SECTOR, pinned and locked, reading the
+   sector from disk on a miss unless WHOLE, which means that the
+   caller will overwrite all of it.  Release it with
+   cache_put().
+
+   If PREFETCH, the sector is being read ahead: returns a null
+   pointer if it is already cached, and otherwise marks the new
+   entry as not used yet. */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool whole, bool prefetch) 
+{
+  struct cache_entry *e;
+
+  for (;;) 
+    {
+      lock_acquire (&cache_lock);
+      e = lookup (sector);
+      if (e != NULL)
+        {
+          if (prefetch)
+            {
+              lock_release (&cache_lock);
+              return NULL;
+            }
+          hit_cnt++;
+          if (e->prefetched)
+            {
+              e->prefetched = false;
+              ahead_used_cnt++;
+            }
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+
+          /* If another thread is still reading the sector in, this
+             waits until it is done. */
+          lock_acquire (&e->lock);
+          return e;
+        }
+
+      e = evict ();
+      if (!e->dirty)
+        break;
+
+      /* Only dirty entries are left to reuse.  Write the victim
+         back without cache_lock, pinned so that no one else takes
+         it meanwhile, and start over, since SECTOR may have been
+         cached in the meantime. */
+      e->pin_cnt++;
+      lock_release (&cache_lock);
+      lock_acquire (&e->lock);
+      write_back (e);
+      lock_release (&e->lock);
+      lock_acquire (&cache_lock);
+      e->pin_cnt--;
+      lock_release (&cache_lock);
+    }
+
+  /* Take over the clean victim.  No one holds the lock of an
+     unpinned entry, so acquiring it here does not wait. */
+  if (prefetch)
+    ahead_cnt++;
+  else
+    miss_cnt++;
+  if (e->valid && e->prefetched)
+    ahead_wasted_cnt++;
+  lock_acquire (&e->lock);
+  e->sector = sector;
+  e->valid = true;
+  e->dirty = false;
+  e->prefetched = prefetch;
+  e->pin_cnt = 1;
+  lock_release (&cache_lock);
+
+  /* Lookups of SECTOR now find the entry and wait on its lock
+     until the read is done. */
+  if (!whole)
+    block_read (fs_device, sector, e->data);
+  return e;
+}
+
+/* Unlocks and unpins E, which was returned by cache_get(). */
+static void
+cache_put (struct cache_entry *e) 
+{
+  e->accessed = true;
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  ASSERT (e->pin_cnt > 0);
+  e->pin_cnt--;
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry that holds SECTOR, or a null pointer if none
+   does.  cache_lock must be held. */
+static struct cache_entry *
+lookup (block_sector_t sector) 
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Chooses an unpinned entry to reuse with the clock algorithm,
+   giving recently used entries a second chance and preferring
+   clean entries, which can be reused without a disk write.
+   Returns a dirty entry only if no clean one is available.
+   cache_lock must be held.  Panics if every entry is pinned,
+   which cannot happen unless more than CACHE_SIZE threads are in
+   the cache at once. */
+static struct cache_entry *
+evict (void) 
+{
+  struct cache_entry *dirty = NULL;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < 2 * CACHE_SIZE; i++) 
+    {
+      struct cache_entry *e = &cache[clock_hand];
+
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+      if (!e->valid)
+        return e;
+      if (e->pin_cnt > 0)
+        continue;
+      if (e->accessed)
+        e->accessed = false;
+      else if (!e->dirty)
+        return e;
+      else if (dirty == NULL)
+        dirty = e;
+    }
+  if (dirty != NULL)
+    return dirty;
+  PANIC ("buffer cache: every entry is pinned");
+}
+
+/* Writes E back to disk if it is dirty.  E's lock must be
+   held. */
+static void
+write_back (struct cache_entry *e) 
+{
+  ASSERT (lock_held_by_current_thread (&e->lock));
+
+  if (e->valid && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      e->dirty = false;
+      writeback_cnt++;
+    }
+}
+
+/* Flusher thread: writes dirty sectors back every
+   FLUSH_INTERVAL ticks, so that a crash loses little data and
+   eviction rarely has to wait for a write. */
+static void
+flusher (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      filesys_sync ();
+    }
+}
+
+/* Read-ahead thread: loads the sectors queued by
+   cache_prefetch(), oldest first. */
+static void
+prefetcher (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      block_sector_t sector;
+      struct cache_entry *e;
+
+      lock_acquire (&prefetch_lock);
+      while (prefetch_cnt == 0)
+        cond_wait (&prefetch_ready, &prefetch_lock);
+      sector = prefetch_queue[prefetch_head];
+      prefetch_head = (prefetch_head + 1) % PREFETCH_QUEUE_SIZE;
+      prefetch_cnt--;
+      lock_release (&prefetch_lock);
+
+      e = cache_get (sector, false, true);
+      if (e != NULL)
+        cache_put (e);
+    }
+}
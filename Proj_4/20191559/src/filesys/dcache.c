@@ -0,0 +1,218 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* Directory entry cache.
+
+   Maps a directory's inode sector and a name in it to the inode
+   sector the name refers to, so that resolving a path costs a
+   hash lookup per component instead of a directory scan.  A
+   negative entry, with sector 0, records that the name does not
+   exist; sector 0 holds the free map, so no name refers to it.
+
+   dir_lookup() fills the cache.  dir_add() and dir_remove()
+   invalidate the entry for the name they change, and removing a
+   directory purges every entry for names in it, so that a new
+   directory that reuses its sector starts with none.  A rename
+   must invalidate the old and the new name in the same way.
+
+   The cache holds DCACHE_SIZE entries and evicts the least
+   recently used one when full.  dcache_lock guards all of it. */
+
+/* Number of cached names. */
+#define DCACHE_SIZE 256
+
+/* A cached name. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dentries. */
+    struct list_elem list_elem;         /* Element in lru or free list. */
+    block_sector_t dir;                 /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Null terminated name. */
+    block_sector_t sector;              /* Inode sector, or 0 if none. */
+  };
+
+static struct dentry dentries[DCACHE_SIZE];
+static struct hash dentry_hash;         /* Entries in use, by key. */
+static struct list lru_list;            /* In use, most recent first. */
+static struct list free_list;           /* Not in use. */
+static struct lock dcache_lock;
+
+/* Statistics. */
+static long long hit_cnt;               /* Positive hits. */
+static long long negative_cnt;          /* Negative hits. */
+static long long miss_cnt;              /* Misses. */
+
+static hash_hash_func dentry_hash_func;
+static hash_less_func dentry_less;
+static struct dentry *find (block_sector_t dir, const char *name);
+static void discard (struct dentry *);
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void) 
+{
+  size_t i;
+
+  if (!hash_init (&dentry_hash, dentry_hash_func, dentry_less, NULL))
+    PANIC ("dentry hash creation failed");
+  list_init (&lru_list);
+  list_init (&free_list);
+  lock_init (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    list_push_back (&free_list, &dentries[i].list_elem);
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   If the cache knows about NAME, returns true and sets *SECTORP
+   to the sector of NAME's inode, or to 0 if NAME does not exist.
+   Returns false if the cache does not know. */
+bool
+dcache_lookup (block_sector_t dir, const char *name,
+               block_sector_t *sectorp) 
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->list_elem);
+      list_push_front (&lru_list, &d->list_elem);
+      *sectorp = d->sector;
+      if (d->sector != 0)
+        hit_cnt++;
+      else
+        negative_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in sector DIR
+   refers to the inode in SECTOR, or does not exist if SECTOR is
+   0. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector) 
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d == NULL)
+    {
+      if (list_empty (&free_list))
+        discard (list_entry (list_back (&lru_list), struct dentry,
+                             list_elem));
+      d = list_entry (list_pop_front (&free_list), struct dentry, list_elem);
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dentry_hash, &d->hash_elem);
+    }
+  else
+    list_remove (&d->list_elem);
+  d->sector = sector;
+  list_push_front (&lru_list, &d->list_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets what the cache knows about NAME in the directory whose
+   inode is in sector DIR. */
+void
+dcache_invalidate (block_sector_t dir, const char *name) 
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    discard (d);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every name in the directory whose inode is in sector
+   DIR.  Takes time proportional to the size of the cache, but is
+   needed only when a directory is removed. */
+void
+dcache_purge_dir (block_sector_t dir) 
+{
+  struct list_elem *e, *next;
+
+  lock_acquire (&dcache_lock);
+  for (e = list_begin (&lru_list); e != list_end (&lru_list); e = next)
+    {
+      struct dentry *d = list_entry (e, struct dentry, list_elem);
+      next = list_next (e);
+      if (d->dir == dir)
+        discard (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void
+dcache_print_stats (void) 
+{
+  printf ("Dcache: %lld hits, %lld negative hits, %lld misses\n",
+          hit_cnt, negative_cnt, miss_cnt);
+}
+
+/* Returns the cached entry for NAME in directory DIR, or a null
+   pointer if there is none. */
+static struct dentry *
+find (block_sector_t dir, const char *name) 
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&dcache_lock));
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentry_hash, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Moves D from the cache to the free list. */
+static void
+discard (struct dentry *d) 
+{
+  ASSERT (lock_held_by_current_thread (&dcache_lock));
+
+  hash_delete (&dentry_hash, &d->hash_elem);
+  list_remove (&d->list_elem);
+  list_push_back (&free_list, &d->list_elem);
+}
+
+/* Returns a hash value for dentry E. */
+static unsigned
+dentry_hash_func (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_int (d->dir) ^ hash_string (d->name);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED) 
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
@@ -1,10 +1,15 @@
 #include "filesys/directory.h"
+#include <bitmap.h>
+#include <hash.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,12 +26,82 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Directory formats.
+
+   A small directory is a linear array of struct dir_entry, which
+   lookups scan from the start.  When dir_add() finds a linear
+   directory full at LINEAR_MAX entries, it converts it to a
+   hashed directory, so that lookups read only a sector or two no
+   matter how large the directory grows.
+
+   A hashed directory begins with a header sector, followed by
+   HASH_BUCKETS buckets of one sector each.  A name lives in the
+   bucket its hash selects or, if that bucket was full when the
+   name was added, in one of the buckets after it.  A bucket
+   that an add ever passed over is marked overflowed, and lookups
+   continue past only such buckets.  Buckets not written yet are
+   holes in the directory file, which read as zeros, that is,
+   empty and not overflowed, and take no disk space.  HASH_BUCKETS
+   buckets hold more entries than there are sectors for their
+   inodes on any disk the indexed inode can address.
+
+   The header's first word is DIR_HASH_MAGIC, which no linear
+   directory's first word can be, because it is larger than any
+   sector number an IDE disk can address.  Directories made
+   larger than a sector at creation stay linear. */
+#define DIR_HASH_MAGIC 0x48534844
+#define HASH_BUCKETS 1024
+#define BUCKET_ENTRIES ((BLOCK_SECTOR_SIZE - sizeof (uint32_t)) \
+                        / sizeof (struct dir_entry))
+#define LINEAR_MAX BUCKET_ENTRIES
+
+/* Header sector of a hashed directory. */
+struct dir_header
+  {
+    uint32_t magic;                     /* DIR_HASH_MAGIC. */
+    uint32_t bucket_cnt;                /* HASH_BUCKETS. */
+    uint32_t unused[126];               /* Not used. */
+  };
+
+/* A bucket of a hashed directory. */
+struct dir_bucket
+  {
+    uint32_t overflowed;                /* Ever skipped by dir_add()? */
+    struct dir_entry entries[BUCKET_ENTRIES];
+  };
+
+/* Guards directory contents.  Lookups hold it for reading, so
+   they run in parallel; dir_add() and dir_remove() hold it for
+   writing, only long enough to find and update one entry.  A
+   lookup also opens the inode it finds before releasing it, so
+   that the inode cannot be removed and freed in between. */
+static struct rwlock dir_lock;
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  rwlock_init (&dir_lock);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, whose parent directory's inode is in sector
+   PARENT, and adds its "." and ".." entries.  Returns true if
+   successful, false on failure. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, size_t entry_cnt, block_sector_t parent)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir *dir;
+  bool success;
+
+  if (!inode_create (sector, entry_cnt * sizeof (struct dir_entry), true))
+    return false;
+  dir = dir_open (inode_open (sector));
+  success = (dir != NULL
+             && dir_add (dir, ".", sector)
+             && dir_add (dir, "..", parent));
+  dir_close (dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -83,6 +158,236 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Sets DIR's position, as returned by dir_tell(), to POS. */
+void
+dir_seek (struct dir *dir, off_t pos) 
+{
+  ASSERT (pos >= 0);
+  dir->pos = pos;
+}
+
+/* Returns DIR's position, which dir_readdir() advances. */
+off_t
+dir_tell (struct dir *dir) 
+{
+  return dir->pos;
+}
+
+static bool readdir (struct dir *, char name[NAME_MAX + 1]);
+
+/* Returns true if NAME is "." or "..". */
+static bool
+is_dot (const char *name) 
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
+
+/* Returns true if INODE holds a hashed directory, false if it
+   holds a linear one. */
+static bool
+is_hashed (struct inode *inode) 
+{
+  uint32_t magic;
+
+  return (inode_read_at (inode, &magic, sizeof magic, 0) == sizeof magic
+          && magic == DIR_HASH_MAGIC);
+}
+
+/* Returns the byte offset of bucket IDX in a hashed directory. */
+static off_t
+bucket_ofs (size_t idx) 
+{
+  return (off_t) (idx + 1) * BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the byte offset of entry SLOT of bucket IDX in a hashed
+   directory. */
+static off_t
+entry_ofs (size_t idx, size_t slot) 
+{
+  return (bucket_ofs (idx) + offsetof (struct dir_bucket, entries)
+          + slot * sizeof (struct dir_entry));
+}
+
+/* Reads bucket IDX of the hashed directory in INODE into *B.
+   Buckets past the end of the directory read as empty. */
+static void
+read_bucket (struct inode *inode, size_t idx, struct dir_bucket *b) 
+{
+  memset (b, 0, sizeof *b);
+  inode_read_at (inode, b, sizeof *b, bucket_ofs (idx));
+}
+
+/* Returns the bucket where NAME's search starts. */
+static size_t
+home_bucket (const char *name) 
+{
+  return hash_string (name) % HASH_BUCKETS;
+}
+
+/* Searches hashed directory DIR for NAME, as lookup() does. */
+static bool
+hash_lookup (const struct dir *dir, const char *name,
+             struct dir_entry *ep, off_t *ofsp) 
+{
+  struct dir_bucket *b = malloc (sizeof *b);
+  size_t idx = home_bucket (name);
+  bool found = false;
+  size_t i, slot;
+
+  if (b == NULL)
+    return false;
+  for (i = 0; i < HASH_BUCKETS && !found; i++)
+    {
+      read_bucket (dir->inode, idx, b);
+      for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+        if (b->entries[slot].in_use && !strcmp (name, b->entries[slot].name))
+          {
+            if (ep != NULL)
+              *ep = b->entries[slot];
+            if (ofsp != NULL)
+              *ofsp = entry_ofs (idx, slot);
+            found = true;
+            break;
+          }
+      if (!b->overflowed)
+        break;
+      idx = (idx + 1) % HASH_BUCKETS;
+    }
+  free (b);
+  return found;
+}
+
+/* Adds entry E to hashed directory DIR, in the first bucket with
+   room at or after E's home bucket.  If TOUCHED is nonnull,
+   marks in it each bucket that this writes to.  Returns true if
+   successful, false if the directory is full or a disk or memory
+   error occurs. */
+static bool
+hash_add (struct dir *dir, const struct dir_entry *e,
+          struct bitmap *touched) 
+{
+  static const uint32_t overflowed = 1;
+  struct dir_bucket *b = malloc (sizeof *b);
+  size_t idx = home_bucket (e->name);
+  bool success = false;
+  size_t i, slot;
+
+  if (b == NULL)
+    return false;
+  for (i = 0; i < HASH_BUCKETS; i++)
+    {
+      read_bucket (dir->inode, idx, b);
+      for (slot = 0; slot < BUCKET_ENTRIES; slot++)
+        if (!b->entries[slot].in_use)
+          break;
+      if (slot < BUCKET_ENTRIES)
+        {
+          success = inode_write_at (dir->inode, e, sizeof *e,
+                                    entry_ofs (idx, slot)) == sizeof *e;
+          if (success && touched != NULL)
+            bitmap_mark (touched, idx);
+          break;
+        }
+      if (!b->overflowed)
+        {
+          if (inode_write_at (dir->inode, &overflowed, sizeof overflowed,
+                              bucket_ofs (idx)) != sizeof overflowed)
+            break;
+          if (touched != NULL)
+            bitmap_mark (touched, idx);
+        }
+      idx = (idx + 1) % HASH_BUCKETS;
+    }
+  free (b);
+  return success;
+}
+
+/* Returns true if linear directory DIR has nothing but zeros
+   past its first sector, which is where make_hashed() puts the
+   buckets.  A directory that was never converted is at most a
+   sector long; one whose conversion failed may be longer, but
+   only zeroed buckets follow its first sector. */
+static bool
+fits_first_sector (struct dir *dir) 
+{
+  static const char zeros[BLOCK_SECTOR_SIZE];
+  off_t length = inode_length (dir->inode);
+  char *buf;
+  bool fits = true;
+  off_t ofs;
+
+  if (length <= BLOCK_SECTOR_SIZE)
+    return true;
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (buf == NULL)
+    return false;
+  for (ofs = BLOCK_SECTOR_SIZE; fits && ofs < length;
+       ofs += BLOCK_SECTOR_SIZE)
+    {
+      off_t n = inode_read_at (dir->inode, buf, BLOCK_SECTOR_SIZE, ofs);
+      fits = n > 0 && !memcmp (buf, zeros, n);
+    }
+  free (buf);
+  return fits;
+}
+
+/* Converts linear directory DIR, whose entries must all lie in
+   its first LINEAR_MAX slots with only zeros after its first
+   sector, to a hashed directory.  The entries go into the
+   buckets first and the header is written last, so that DIR
+   stays a valid linear directory if that fails.  Returns true if
+   successful, false on failure. */
+static bool
+make_hashed (struct dir *dir) 
+{
+  static const char zeros[BLOCK_SECTOR_SIZE];
+  struct dir_header *h = NULL;
+  struct dir_entry *entries;
+  struct bitmap *touched;
+  off_t length = inode_length (dir->inode);
+  size_t cnt;
+  bool success = false;
+  size_t i;
+
+  if (length > (off_t) (LINEAR_MAX * sizeof *entries))
+    length = LINEAR_MAX * sizeof *entries;
+  cnt = length / sizeof *entries;
+
+  entries = malloc (length);
+  touched = bitmap_create (HASH_BUCKETS);
+  if (entries == NULL || touched == NULL
+      || inode_read_at (dir->inode, entries, length, 0) != length)
+    goto done;
+  for (i = 0; i < cnt; i++)
+    if (entries[i].in_use && !hash_add (dir, &entries[i], touched))
+      {
+        /* Erase the buckets written so far, which a later attempt
+           needs to find empty.  They are already allocated, so
+           this cannot run out of space. */
+        size_t idx;
+        for (idx = 0; idx < HASH_BUCKETS; idx++)
+          if (bitmap_test (touched, idx))
+            inode_write_at (dir->inode, zeros, BLOCK_SECTOR_SIZE,
+                            bucket_ofs (idx));
+        goto done;
+      }
+
+  h = calloc (1, sizeof *h);
+  if (h == NULL)
+    goto done;
+  h->magic = DIR_HASH_MAGIC;
+  h->bucket_cnt = HASH_BUCKETS;
+  success = inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+
+ done:
+  free (h);
+  if (touched != NULL)
+    bitmap_destroy (touched);
+  free (entries);
+  return success;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -98,6 +403,9 @@ lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (is_hashed (dir->inode))
+    return hash_lookup (dir, name, ep, ofsp);
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -114,20 +422,28 @@ lookup (const struct dir *dir, const char *name,
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   Consults the directory entry cache first and records what a
+   search finds there, whether or not NAME exists. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector, sector;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  dir_sector = inode_get_inumber (dir->inode);
+  rwlock_acquire_read (&dir_lock);
+  if (!dcache_lookup (dir_sector, name, &sector))
+    {
+      sector = lookup (dir, name, &e, NULL) ? e.inode_sector : 0;
+      dcache_insert (dir_sector, name, sector);
+    }
+  *inode = sector != 0 ? inode_open (sector) : NULL;
+  rwlock_release_read (&dir_lock);
 
   return *inode != NULL;
 }
@@ -136,12 +452,12 @@ dir_lookup (const struct dir *dir, const char *name,
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long), DIR has been removed,
+   or a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
-  struct dir_entry e;
+  struct dir_entry e, slot;
   off_t ofs;
   bool success = false;
 
@@ -152,10 +468,22 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  rwlock_acquire_write (&dir_lock);
+
+  /* Check that NAME is not in use, and that DIR can still gain
+     entries. */
+  if (lookup (dir, name, NULL, NULL) || inode_is_removed (dir->inode))
     goto done;
 
+  e.in_use = true;
+  strlcpy (e.name, name, sizeof e.name);
+  e.inode_sector = inode_sector;
+  if (is_hashed (dir->inode))
+    {
+      success = hash_add (dir, &e, NULL);
+      goto done;
+    }
+
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
      current end-of-file.
@@ -163,24 +491,35 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
+  for (ofs = 0; ; ofs += sizeof slot) 
+    if (inode_read_at (dir->inode, &slot, sizeof slot, ofs) != sizeof slot
+        || !slot.in_use)
       break;
 
+  /* A full linear directory that is about to outgrow a sector
+     becomes hashed instead.  That includes one whose earlier
+     conversion failed and left zeroed buckets behind. */
+  if (ofs >= (off_t) (LINEAR_MAX * sizeof e) && fits_first_sector (dir))
+    {
+      success = make_hashed (dir) && hash_add (dir, &e, NULL);
+      goto done;
+    }
+
   /* Write slot. */
-  e.in_use = true;
-  strlcpy (e.name, name, sizeof e.name);
-  e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
+  rwlock_release_write (&dir_lock);
   return success;
 }
 
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs if
+   there is no file with the given NAME, if NAME is "." or "..",
+   or if NAME is a directory that is not empty or that anyone
+   else has open, including as a working directory. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
@@ -192,6 +531,11 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (is_dot (name))
+    return false;
+
+  rwlock_acquire_write (&dir_lock);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -201,36 +545,86 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* Only an empty directory that no one else is using may go. */
+  if (inode_is_dir (inode))
+    {
+      struct dir child = {inode, 0};
+      char child_name[NAME_MAX + 1];
+
+      if (inode_open_cnt (inode) > 1 || readdir (&child, child_name))
+        goto done;
+    }
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
-  /* Remove inode. */
+  /* Remove inode, and what the cache knows about it. */
   inode_remove (inode);
+  dcache_insert (inode_get_inumber (dir->inode), name, 0);
+  if (inode_is_dir (inode))
+    dcache_purge_dir (e.inode_sector);
   success = true;
 
  done:
+  rwlock_release_write (&dir_lock);
   inode_close (inode);
   return success;
 }
 
-/* Reads the next directory entry in DIR and stores the name in
-   NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
-bool
-dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+/* Reads the next directory entry in DIR, other than "." and
+   "..", and stores the name in NAME.  Returns true if successful,
+   false if the directory contains no more entries.  In a linear
+   directory, DIR's position is a byte offset; in a hashed one, it
+   counts entry slots from the start of the first bucket.  The
+   caller must hold dir_lock. */
+static bool
+readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  if (is_hashed (dir->inode))
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      for (;; dir->pos++)
         {
-          strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
-        } 
+          size_t idx = dir->pos / BUCKET_ENTRIES;
+          size_t slot = dir->pos % BUCKET_ENTRIES;
+          if (bucket_ofs (idx) >= inode_length (dir->inode)
+              || inode_read_at (dir->inode, &e, sizeof e,
+                                entry_ofs (idx, slot)) != sizeof e)
+            return false;
+          if (e.in_use && !is_dot (e.name))
+            {
+              strlcpy (name, e.name, NAME_MAX + 1);
+              dir->pos++;
+              return true;
+            }
+        }
     }
+  else
+    while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+      {
+        dir->pos += sizeof e;
+        if (e.in_use && !is_dot (e.name))
+          {
+            strlcpy (name, e.name, NAME_MAX + 1);
+            return true;
+          } 
+      }
   return false;
 }
+
+/* Reads the next directory entry in DIR, other than "." and
+   "..", and stores the name in NAME.  Returns true if successful,
+   false if the directory contains no more entries. */
+bool
+dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  bool found;
+
+  rwlock_acquire_read (&dir_lock);
+  found = readdir (dir, name);
+  rwlock_release_read (&dir_lock);
+  return found;
+}
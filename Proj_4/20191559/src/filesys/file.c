@@ -1,7 +1,10 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+
+/* Longest read-ahead window, in sectors. */
+#define READ_AHEAD_MAX 16
 
 /* An open file. */
 struct file 
@@ -9,26 +12,45 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+
+    /* Read-ahead state, for file_read(). */
+    off_t ra_next;              /* Offset a sequential read starts at. */
+    off_t ra_end;               /* End of data already read ahead. */
+    int ra_window;              /* Sectors to read ahead. */
   };
 
+static void read_ahead (struct file *, off_t ofs, off_t size);
+
+/* Cache of open files. */
+static struct slab_cache *file_cache;
+
+/* Initializes the open file cache. */
+void
+file_init (void)
+{
+  file_cache = slab_cache_create ("file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = slab_alloc (file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      slab_free (file_cache, file);
       return NULL; 
     }
 }
@@ -49,7 +71,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      slab_free (file_cache, file); 
     }
 }
 
@@ -64,11 +86,14 @@ file_get_inode (struct file *file)
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   If FILE is being read sequentially, also starts reading the
+   data after it into the buffer cache. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -87,9 +112,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +126,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -166,3 +189,41 @@ file_tell (struct file *file)
   ASSERT (file != NULL);
   return file->pos;
 }
+
+/* Updates FILE's read-ahead state after a read of SIZE bytes at
+   OFS.  A read that starts where the previous one ended doubles
+   the read-ahead window, up to READ_AHEAD_MAX sectors, and
+   queues whatever part of the window past the read is not
+   already queued.  Any other read halves the window, so that
+   random access soon stops reading ahead. */
+static void
+read_ahead (struct file *file, off_t ofs, off_t size) 
+{
+  off_t end = ofs + size;
+  off_t start, limit;
+
+  if (size == 0)
+    return;
+
+  if (ofs != file->ra_next)
+    {
+      file->ra_window /= 2;
+      file->ra_next = end;
+      file->ra_end = 0;
+      return;
+    }
+  file->ra_next = end;
+
+  if (file->ra_window == 0)
+    file->ra_window = 1;
+  else if (file->ra_window < READ_AHEAD_MAX)
+    file->ra_window *= 2;
+
+  start = end > file->ra_end ? end : file->ra_end;
+  limit = end + file->ra_window * BLOCK_SECTOR_SIZE;
+  if (start < limit)
+    {
+      inode_prefetch (file->inode, limit - start, start);
+      file->ra_end = limit;
+    }
+}
@@ -2,15 +2,20 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
 static void do_format (void);
+static struct dir *resolve_parent (const char *path,
+                                   char name[NAME_MAX + 1]);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -21,7 +26,11 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
+  dcache_init ();
   inode_init ();
+  file_init ();
+  dir_init ();
   free_map_init ();
 
   if (format) 
@@ -36,6 +45,16 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  cache_flush ();
+}
+
+/* Writes all unwritten data, including changes to the free map,
+   to disk. */
+void
+filesys_sync (void) 
+{
+  free_map_sync ();
+  cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -45,12 +64,13 @@ filesys_done (void)
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
+  char base[NAME_MAX + 1];
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
+  struct dir *dir = resolve_parent (name, base);
   bool success = (dir != NULL
                   && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+                  && inode_create (inode_sector, initial_size, false)
+                  && dir_add (dir, base, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
@@ -58,7 +78,40 @@ filesys_create (const char *name, off_t initial_size)
   return success;
 }
 
-/* Opens the file with the given NAME.
+/* Creates a directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file named NAME already exists,
+   or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name) 
+{
+  char base[NAME_MAX + 1];
+  block_sector_t inode_sector = 0;
+  struct dir *dir = resolve_parent (name, base);
+  bool success = (dir != NULL
+                  && free_map_allocate (1, &inode_sector)
+                  && dir_create (inode_sector, 16,
+                                 inode_get_inumber (dir_get_inode (dir))));
+  if (success && !dir_add (dir, base, inode_sector))
+    {
+      /* Removing the new directory releases its sector, too. */
+      struct inode *inode = inode_open (inode_sector);
+      if (inode != NULL)
+        {
+          inode_remove (inode);
+          inode_close (inode);
+          inode_sector = 0;
+        }
+      success = false;
+    }
+  if (!success && inode_sector != 0) 
+    free_map_release (inode_sector, 1);
+  dir_close (dir);
+
+  return success;
+}
+
+/* Opens the file or directory with the given NAME.
    Returns the new file if successful or a null pointer
    otherwise.
    Fails if no file named NAME exists,
@@ -66,37 +119,156 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
+  char base[NAME_MAX + 1];
+  struct dir *dir = resolve_parent (name, base);
   struct inode *inode = NULL;
 
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    dir_lookup (dir, base, &inode);
   dir_close (dir);
 
   return file_open (inode);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file or empty directory named NAME.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if no file named NAME exists, if NAME is a directory
+   that is not empty or is in use, or if an internal memory
+   allocation fails. */
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char base[NAME_MAX + 1];
+  struct dir *dir = resolve_parent (name, base);
+  bool success = dir != NULL && dir_remove (dir, base);
   dir_close (dir); 
 
   return success;
 }
-
+
+/* Changes the current thread's working directory to NAME.
+   Returns true if successful, false if NAME is not a
+   directory. */
+bool
+filesys_chdir (const char *name) 
+{
+  char base[NAME_MAX + 1];
+  struct dir *dir = resolve_parent (name, base);
+  struct inode *inode = NULL;
+
+  if (dir != NULL)
+    dir_lookup (dir, base, &inode);
+  dir_close (dir);
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+
+#ifdef USERPROG
+  dir_close (thread_current ()->cwd);
+  thread_current ()->cwd = dir_open (inode);
+  return thread_current ()->cwd != NULL;
+#else
+  inode_close (inode);
+  return true;
+#endif
+}
+
+/* Returns a new handle on the current thread's working
+   directory, which is the root directory unless the thread has
+   changed it. */
+static struct dir *
+open_cwd (void) 
+{
+#ifdef USERPROG
+  if (thread_current ()->cwd != NULL)
+    return dir_reopen (thread_current ()->cwd);
+#endif
+  return dir_open_root ();
+}
+
+/* Copies the next component of the path in *SRCP into PART and
+   advances *SRCP past it.  Returns 1 if successful, 0 at the end
+   of the path, or -1 if the component is longer than NAME_MAX. */
+static int
+next_part (char part[NAME_MAX + 1], const char **srcp) 
+{
+  const char *src = *srcp;
+  char *dst = part;
+
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  while (*src != '/' && *src != '\0') 
+    {
+      if (dst < part + NAME_MAX)
+        *dst++ = *src;
+      else
+        return -1;
+      src++;
+    }
+  *dst = '\0';
+
+  *srcp = src;
+  return 1;
+}
+
+/* Opens the directory that contains the last component of PATH
+   and copies that component into NAME.  A relative PATH starts
+   from the current thread's working directory.  A PATH with no
+   components, such as "/", yields "." in the directory it
+   starts from.  Returns the directory, which the caller must
+   close, or a null pointer if PATH is empty, a component is too
+   long, or a directory along the way does not exist. */
+static struct dir *
+resolve_parent (const char *path, char name[NAME_MAX + 1]) 
+{
+  char part[NAME_MAX + 1];
+  struct dir *dir;
+  int status;
+
+  if (*path == '\0')
+    return NULL;
+
+  dir = *path == '/' ? dir_open_root () : open_cwd ();
+  strlcpy (name, ".", NAME_MAX + 1);
+  while (dir != NULL && (status = next_part (part, &path)) != 0)
+    {
+      if (status < 0)
+        {
+          dir_close (dir);
+          return NULL;
+        }
+
+      /* NAME is not the last component, so step into it. */
+      if (strcmp (name, "."))
+        {
+          struct inode *inode;
+
+          dir_lookup (dir, name, &inode);
+          dir_close (dir);
+          if (inode != NULL && !inode_is_dir (inode))
+            {
+              inode_close (inode);
+              inode = NULL;
+            }
+          dir = dir_open (inode);
+        }
+      strlcpy (name, part, NAME_MAX + 1);
+    }
+  return dir;
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
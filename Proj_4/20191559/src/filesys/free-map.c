@@ -1,52 +1,137 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <limits.h>
+#include <round.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct bitmap *dirty_map;     /* Free map file sectors to write. */
+
+/* Guards FREE_MAP, DIRTY_MAP and the free map file.  Held only
+   while allocating or releasing sectors and in free_map_sync(),
+   never across other file system I/O. */
+static struct lock free_map_lock;
+
+/* Where free_map_allocate() starts its next search.  Only a hint,
+   so it is read and written without the lock. */
+static block_sector_t next_fit;
+
+/* Free map file sectors written by free_map_sync(). */
+static long long sync_cnt;
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  lock_init (&free_map_lock);
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  dirty_map = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                           BLOCK_SECTOR_SIZE));
+  if (dirty_map == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+}
+
+/* Marks the free map file sectors that hold the bits for CNT
+   sectors starting at SECTOR as needing to be written. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt) 
+{
+  size_t bits_per_sector = BLOCK_SECTOR_SIZE * CHAR_BIT;
+  size_t first = sector / bits_per_sector;
+  size_t last = (sector + cnt - 1) / bits_per_sector;
+
+  ASSERT (lock_held_by_current_thread (&free_map_lock));
+  bitmap_set_multiple (dirty_map, first, last - first + 1, true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  Allocation is next-fit: the search
+   starts where the last call to this function left off.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
-    {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
-    }
+  block_sector_t sector;
+
+  if (!free_map_allocate_near (next_fit, cnt, &sector))
+    return false;
+  next_fit = sector + cnt;
+  *sectorp = sector;
+  return true;
+}
+
+/* Allocates CNT consecutive sectors from the free map and stores
+   the first into *SECTORP, choosing the first free run at or
+   after sector GOAL, or failing that the first one anywhere.
+   The change reaches the free map file at the next
+   free_map_sync().
+   Returns true if successful, false if not enough consecutive
+   sectors were available. */
+bool
+free_map_allocate_near (block_sector_t goal, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  block_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  if (goal >= bitmap_size (free_map))
+    goal = 0;
+  sector = bitmap_scan_and_flip (free_map, goal, cnt, false);
+  if (sector == BITMAP_ERROR && goal > 0)
+    sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  if (sector != BITMAP_ERROR)
+    mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use.
+   The change reaches the free map file at the next
+   free_map_sync(). */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
+}
+
+/* Writes the sectors of the free map that changed since the last
+   call to the free map file, which puts them in the buffer
+   cache.  Does nothing before the free map file is open. */
+void
+free_map_sync (void) 
+{
+  size_t i;
+
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    for (i = 0; i < bitmap_size (dirty_map); i++)
+      if (bitmap_test (dirty_map, i))
+        {
+          if (!bitmap_write_part (free_map, free_map_file,
+                                  i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE))
+            PANIC ("can't write free map");
+          bitmap_reset (dirty_map, i);
+          sync_cnt++;
+        }
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -64,7 +149,11 @@ free_map_open (void)
 void
 free_map_close (void) 
 {
+  free_map_sync ();
+  lock_acquire (&free_map_lock);
   file_close (free_map_file);
+  free_map_file = NULL;
+  lock_release (&free_map_lock);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -72,14 +161,32 @@ free_map_close (void)
 void
 free_map_create (void) 
 {
+  struct file *file;
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map),
+                     false))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  /* Write bitmap to file.  The first write allocates the file's
+     sectors, which changes the free map, so only afterward is the
+     file handed to free_map_allocate() and written again. */
+  file = file_open (inode_open (FREE_MAP_SECTOR));
+  if (file == NULL)
     PANIC ("can't open free map");
+  if (!bitmap_write (free_map, file))
+    PANIC ("can't write free map");
+  lock_acquire (&free_map_lock);
+  free_map_file = file;
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_map, false);
+  lock_release (&free_map_lock);
+}
+
+/* Prints free map statistics. */
+void
+free_map_print_stats (void) 
+{
+  printf ("Free map: %lld sectors written\n", sync_cnt);
 }
@@ -7,6 +7,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -28,6 +29,37 @@ fsutil_ls (char **argv UNUSED)
   printf ("End of listing.\n");
 }
 
+/* Reports how many extents hold each file in the root directory,
+   as a measure of fragmentation. */
+void
+fsutil_frag (char **argv UNUSED) 
+{
+  struct dir *dir;
+  char name[NAME_MAX + 1];
+  size_t file_cnt = 0, extent_cnt = 0;
+  
+  printf ("Extents of files in the root directory:\n");
+  dir = dir_open_root ();
+  if (dir == NULL)
+    PANIC ("root dir open failed");
+  while (dir_readdir (dir, name))
+    {
+      struct file *file = filesys_open (name);
+      size_t cnt;
+
+      if (file == NULL)
+        continue;
+      cnt = inode_extent_cnt (file_get_inode (file));
+      printf ("%s: %"PROTd" bytes in %zu extents\n",
+              name, file_length (file), cnt);
+      file_cnt++;
+      extent_cnt += cnt;
+      file_close (file);
+    }
+  dir_close (dir);
+  printf ("%zu files in %zu extents.\n", file_cnt, extent_cnt);
+}
+
 /* Prints the contents of file ARGV[1] to the system console as
    hex and ASCII. */
 void
@@ -110,7 +142,11 @@ fsutil_extract (char **argv UNUSED)
           break;
         }
       else if (type == USTAR_DIRECTORY)
-        printf ("ignoring directory %s\n", file_name);
+        {
+          printf ("Making directory '%s'...\n", file_name);
+          if (!filesys_mkdir (file_name))
+            PANIC ("%s: mkdir failed", file_name);
+        }
       else if (type == USTAR_REGULAR)
         {
           struct file *dst;
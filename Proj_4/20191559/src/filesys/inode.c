@@ -2,33 +2,57 @@
 #include <list.h>
 #include <debug.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of data sectors named directly by an inode. */
+#define DIRECT_CNT 123
+
+/* Number of sector numbers in an index sector. */
+#define PTRS_PER_SECTOR ((off_t) (BLOCK_SECTOR_SIZE / sizeof (block_sector_t)))
+
+/* Largest number of data sectors an inode can index. */
+#define MAX_SECTORS (DIRECT_CNT + PTRS_PER_SECTOR \
+                     + PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   The first DIRECT_CNT data sectors are named in DIRECT, the next
+   PTRS_PER_SECTOR in the index sector INDIRECT, and the rest in
+   the index sectors named by the index sector DOUBLY_INDIRECT.
+   Sector 0 holds the free map, so it is never a data or index
+   sector; a 0 in any of these slots means that nothing has been
+   allocated there yet.  Such holes read as zeros. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
+    block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+    block_sector_t indirect;            /* Indirect index sector. */
+    block_sector_t doubly_indirect;     /* Doubly indirect index sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t is_dir;                    /* Nonzero for a directory. */
   };
 
-/* Returns the number of sectors to allocate for an inode SIZE
-   bytes long. */
-static inline size_t
-bytes_to_sectors (off_t size)
-{
-  return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
-}
+/* In-memory inode.
 
-/* In-memory inode. */
+   Each inode has its own readers-writer lock, so that I/O on
+   different files never waits on each other and reads of one
+   file overlap.  inode_read_at() holds it for reading and
+   inode_write_at() for writing; it also guards DATA.  OPEN_CNT,
+   REMOVED, DENY_WRITE_CNT and membership in the open inode list
+   are guarded by open_inodes_lock instead, so that loading or
+   exiting a program never queues a writer on its executable. */
 struct inode 
   {
     struct list_elem elem;              /* Element in inode list. */
@@ -36,41 +60,238 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock lock;                 /* Guards data and I/O. */
+    bool dirty;                         /* DATA changed since last written. */
+    block_sector_t goal;                /* Where to allocate next. */
+    block_sector_t resv_start;          /* First sector reserved for data. */
+    size_t resv_cnt;                    /* Number of sectors reserved. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* I/O and allocation statistics. */
+static long long read_cnt;      /* # of inode_read_at() calls. */
+static long long write_cnt;     /* # of inode_write_at() calls. */
+static int io_active;           /* Threads now in read or write. */
+static int io_peak;             /* Largest IO_ACTIVE seen. */
+static long long extents_reserved; /* # of reserve_extent() successes. */
+
+static void io_begin (long long *cnt);
+static void io_end (void);
+
+/* If *SECTORP is 0 and CREATE is true, allocates a sector for it
+   and fills the sector with zeros.  A DATA sector comes from
+   INODE's reservation while it lasts; other sectors, and data
+   sectors beyond the reservation, are allocated as close after
+   INODE's goal as possible.  Returns true if *SECTORP is nonzero
+   afterward. */
+static bool
+fill_slot (struct inode *inode, block_sector_t *sectorp, bool create,
+           bool data) 
+{
+  static const char zeros[BLOCK_SECTOR_SIZE];
+
+  if (*sectorp != 0 || !create)
+    return *sectorp != 0;
+
+  if (data && inode->resv_cnt > 0)
+    {
+      *sectorp = inode->resv_start++;
+      inode->resv_cnt--;
+    }
+  else if (!free_map_allocate_near (inode->goal, 1, sectorp))
+    return false;
+  if (data)
+    inode->goal = *sectorp + 1;
+  cache_write (*sectorp, zeros, 0, BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/* Returns the sector number in slot IDX of index sector INDEX.
+   If the slot is empty and CREATE is true, allocates a zeroed
+   sector for it first, as fill_slot() does for INODE.  Returns 0
+   if the slot is still empty. */
+static block_sector_t
+index_slot (struct inode *inode, block_sector_t index, off_t idx,
+            bool create, bool data) 
+{
+  block_sector_t sector;
+  off_t ofs = idx * sizeof sector;
+
+  cache_read (index, &sector, ofs, sizeof sector);
+  if (sector == 0 && fill_slot (inode, &sector, create, data))
+    cache_write (index, &sector, ofs, sizeof sector);
+  return sector;
+}
+
 /* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   within INODE.  If no sector has been allocated there and CREATE
+   is true, allocates one, along with any index sectors needed to
+   reach it, and marks INODE dirty.
+   Returns 0 if there is no sector there: a hole, an offset past
+   the largest file size, or a failed allocation.  The caller must
+   hold INODE's lock, for writing if CREATE is true. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos, bool create) 
 {
+  struct inode_disk *d = &inode->data;
+  off_t idx = pos / BLOCK_SECTOR_SIZE;
+  block_sector_t old_indirect = d->indirect;
+  block_sector_t old_doubly = d->doubly_indirect;
+  block_sector_t sector = 0;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+  ASSERT (pos >= 0);
+
+  if (idx < DIRECT_CNT)
+    {
+      if (d->direct[idx] == 0 && fill_slot (inode, &d->direct[idx],
+                                            create, true))
+        inode->dirty = true;
+      return d->direct[idx];
+    }
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    {
+      if (fill_slot (inode, &d->indirect, create, false))
+        sector = index_slot (inode, d->indirect, idx, create, true);
+    }
   else
-    return -1;
+    {
+      idx -= PTRS_PER_SECTOR;
+      if (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR
+          && fill_slot (inode, &d->doubly_indirect, create, false))
+        {
+          block_sector_t index = index_slot (inode, d->doubly_indirect,
+                                             idx / PTRS_PER_SECTOR,
+                                             create, false);
+          if (index != 0)
+            sector = index_slot (inode, index, idx % PTRS_PER_SECTOR,
+                                 create, true);
+        }
+    }
+
+  if (d->indirect != old_indirect || d->doubly_indirect != old_doubly)
+    inode->dirty = true;
+  return sector;
+}
+
+/* Reserves one extent for the holes that a write of SIZE bytes at
+   OFFSET into INODE is about to fill, so that they are allocated
+   together instead of one sector at a time.  The extent starts as
+   close as possible after the file's data sector just before
+   OFFSET.  If no free run is long enough, reserves the longest
+   power-of-two fraction of it that fits. */
+static void
+reserve_extent (struct inode *inode, off_t size, off_t offset) 
+{
+  off_t first = offset / BLOCK_SECTOR_SIZE;
+  off_t end = DIV_ROUND_UP (offset + size, BLOCK_SECTOR_SIZE);
+  size_t cnt = 0;
+  off_t i;
+
+  ASSERT (inode->resv_cnt == 0);
+
+  for (i = first; i < end && i < MAX_SECTORS; i++)
+    if (byte_to_sector (inode, i * BLOCK_SECTOR_SIZE, false) == 0)
+      cnt++;
+  if (cnt == 0)
+    return;
+
+  if (first > 0)
+    {
+      block_sector_t prev = byte_to_sector (inode,
+                                            (first - 1) * BLOCK_SECTOR_SIZE,
+                                            false);
+      if (prev != 0)
+        inode->goal = prev + 1;
+    }
+
+  for (; cnt > 0; cnt /= 2)
+    if (free_map_allocate_near (inode->goal, cnt, &inode->resv_start))
+      {
+        enum intr_level old_level = intr_disable ();
+        extents_reserved++;
+        intr_set_level (old_level);
+        inode->resv_cnt = cnt;
+        break;
+      }
+}
+
+/* Returns the part of INODE's reservation that went unused. */
+static void
+release_extent (struct inode *inode) 
+{
+  if (inode->resv_cnt > 0)
+    {
+      free_map_release (inode->resv_start, inode->resv_cnt);
+      inode->resv_cnt = 0;
+    }
+}
+
+/* Frees the data sectors named in index sector INDEX, which is
+   LEVEL levels above them, and INDEX itself. */
+static void
+release_index (block_sector_t index, int level) 
+{
+  block_sector_t slots[PTRS_PER_SECTOR];
+  off_t i;
+
+  if (index == 0)
+    return;
+  cache_read (index, slots, 0, BLOCK_SECTOR_SIZE);
+  for (i = 0; i < PTRS_PER_SECTOR; i++)
+    if (slots[i] != 0)
+      {
+        if (level > 1)
+          release_index (slots[i], level - 1);
+        else
+          free_map_release (slots[i], 1);
+      }
+  free_map_release (index, 1);
+}
+
+/* Frees every data and index sector allocated to INODE. */
+static void
+release_sectors (struct inode *inode) 
+{
+  struct inode_disk *d = &inode->data;
+  int i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    if (d->direct[i] != 0)
+      free_map_release (d->direct[i], 1);
+  release_index (d->indirect, 1);
+  release_index (d->doubly_indirect, 2);
 }
 
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
+static struct lock open_inodes_lock;
+
+/* Cache of in-memory inodes. */
+static struct slab_cache *inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  lock_init (&open_inodes_lock);
+  inode_cache = slab_cache_create ("inode", sizeof (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The inode is a directory if IS_DIR is true, otherwise
+   an ordinary file.  No data sectors are allocated yet: the data
+   reads as zeros until it is written.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
+   Returns false if memory allocation fails or LENGTH is larger
+   than an inode can index. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -81,25 +302,17 @@ inode_create (block_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+  if (DIV_ROUND_UP (length, BLOCK_SECTOR_SIZE) > MAX_SECTORS)
+    return false;
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
+      disk_inode->is_dir = is_dir;
+      cache_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      success = true; 
       free (disk_inode);
     }
   return success;
@@ -114,6 +327,8 @@ inode_open (block_sector_t sector)
   struct list_elem *e;
   struct inode *inode;
 
+  lock_acquire (&open_inodes_lock);
+
   /* Check whether this inode is already open. */
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e)) 
@@ -121,23 +336,32 @@ inode_open (block_sector_t sector)
       inode = list_entry (e, struct inode, elem);
       if (inode->sector == sector) 
         {
-          inode_reopen (inode);
+          inode->open_cnt++;
+          lock_release (&open_inodes_lock);
           return inode; 
         }
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = slab_alloc (inode_cache);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  Read the inode before anyone else can find it. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->dirty = false;
+  inode->goal = sector + 1;
+  inode->resv_cnt = 0;
+  rwlock_init (&inode->lock);
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  list_push_front (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +370,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -168,21 +396,24 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
+  lock_acquire (&open_inodes_lock);
   if (--inode->open_cnt == 0)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
+      lock_release (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          release_sectors (inode);
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      slab_free (inode_cache, inode); 
     }
+  else
+    lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -191,7 +422,9 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  lock_acquire (&open_inodes_lock);
   inode->removed = true;
+  lock_release (&open_inodes_lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -202,12 +435,13 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  rwlock_acquire_read (&inode->lock);
+  io_begin (&read_cnt);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset, false);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -220,110 +454,131 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      if (sector_idx != 0)
+        cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  io_end ();
+  rwlock_release_read (&inode->lock);
 
   return bytes_read;
 }
 
+/* Returns true if writes to INODE are denied. */
+static bool
+writes_denied (struct inode *inode) 
+{
+  bool denied;
+
+  lock_acquire (&open_inodes_lock);
+  denied = inode->deny_write_cnt > 0;
+  lock_release (&open_inodes_lock);
+  return denied;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or the file reaches its
+   largest size.  A write past end of file extends the inode;
+   any gap between the old end and OFFSET is left as a hole. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
-  if (inode->deny_write_cnt)
+  /* Check for denied writes before waiting for the lock, too, so
+     that a write to a running executable cannot hold up the
+     readers that page the executable in. */
+  if (writes_denied (inode))
     return 0;
+  rwlock_acquire_write (&inode->lock);
+  if (writes_denied (inode))
+    {
+      rwlock_release_write (&inode->lock);
+      return 0;
+    }
 
+  io_begin (&write_cnt);
+  reserve_extent (inode, size, offset);
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset, true);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
-
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
+      int chunk_size = size < sector_left ? size : sector_left;
+      if (sector_idx == 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /* The cache reads in the rest of the sector first, unless
+         the chunk covers all of it. */
+      cache_write (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+  release_extent (inode);
+
+  /* Extend the file only once its new data is in place, so that
+     no reader sees a length that covers unwritten bytes. */
+  if (bytes_written > 0 && offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      inode->dirty = true;
+    }
+  if (inode->dirty)
+    {
+      cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+      inode->dirty = false;
+    }
+  io_end ();
+  rwlock_release_write (&inode->lock);
 
   return bytes_written;
 }
 
+/* Queues the sectors that hold SIZE bytes of INODE, starting at
+   OFFSET, to be read into the buffer cache in the background.
+   Bytes past the end of INODE and holes are ignored. */
+void
+inode_prefetch (struct inode *inode, off_t size, off_t offset) 
+{
+  off_t end;
+
+  rwlock_acquire_read (&inode->lock);
+  end = offset + size < inode_length (inode) ? offset + size
+                                             : inode_length (inode);
+  for (offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); offset < end;
+       offset += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, offset, false);
+      if (sector != 0)
+        cache_prefetch (sector);
+    }
+  rwlock_release_read (&inode->lock);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&open_inodes_lock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +587,65 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&open_inodes_lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&open_inodes_lock);
+}
+
+/* Returns true if INODE is a directory, false if it is an
+   ordinary file. */
+bool
+inode_is_dir (const struct inode *inode) 
+{
+  return inode->data.is_dir != 0;
+}
+
+/* Returns true if INODE has been removed, so that it will be
+   deleted when its last opener closes it. */
+bool
+inode_is_removed (struct inode *inode) 
+{
+  bool removed;
+
+  lock_acquire (&open_inodes_lock);
+  removed = inode->removed;
+  lock_release (&open_inodes_lock);
+  return removed;
+}
+
+/* Returns the number of openers INODE has. */
+int
+inode_open_cnt (struct inode *inode) 
+{
+  int open_cnt;
+
+  lock_acquire (&open_inodes_lock);
+  open_cnt = inode->open_cnt;
+  lock_release (&open_inodes_lock);
+  return open_cnt;
+}
+
+/* Returns the number of extents, that is, runs of consecutive
+   sectors, that hold INODE's data.  Holes are not counted. */
+size_t
+inode_extent_cnt (struct inode *inode) 
+{
+  block_sector_t prev = 0;
+  size_t cnt = 0;
+  off_t pos;
+
+  rwlock_acquire_read (&inode->lock);
+  for (pos = 0; pos < inode_length (inode); pos += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, pos, false);
+      if (sector != 0 && (cnt == 0 || sector != prev + 1))
+        cnt++;
+      prev = sector;
+    }
+  rwlock_release_read (&inode->lock);
+  return cnt;
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +654,33 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Prints inode I/O statistics. */
+void
+inode_print_stats (void) 
+{
+  printf ("Inode: %lld reads, %lld writes, peak %d concurrent, "
+          "%lld extents reserved\n",
+          read_cnt, write_cnt, io_peak, extents_reserved);
+}
+
+/* Counts the start of a read or write in *CNT, and tracks how
+   many are in progress at once. */
+static void
+io_begin (long long *cnt) 
+{
+  enum intr_level old_level = intr_disable ();
+  (*cnt)++;
+  if (++io_active > io_peak)
+    io_peak = io_active;
+  intr_set_level (old_level);
+}
+
+/* Counts the end of a read or write. */
+static void
+io_end (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  io_active--;
+  intr_set_level (old_level);
+}
@@ -28,6 +28,8 @@ struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    bool use_hint;      /* Maintain FREE_HINT? */
+    size_t free_hint;   /* Every bit below this index is true. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -46,6 +48,27 @@ bit_mask (size_t bit_idx)
   return (elem_type) 1 << (bit_idx % ELEM_BITS);
 }
 
+/* Returns an elem_type with bits LO through HI - 1 turned on,
+   where 0 <= LO < HI <= ELEM_BITS. */
+static inline elem_type
+range_mask (size_t lo, size_t hi)
+{
+  elem_type high = hi < ELEM_BITS ? ((elem_type) 1 << hi) - 1 : (elem_type) -1;
+  return high & ~(((elem_type) 1 << lo) - 1);
+}
+
+/* Returns the number of 1-bits in X.  Assumes the 32-bit
+   elem_type of our i386 target. */
+static inline size_t
+popcount (elem_type x)
+{
+  /* Sum adjacent bits, then pairs, then nibbles, then bytes. */
+  x = x - ((x >> 1) & 0x55555555);
+  x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+  x = (x + (x >> 4)) & 0x0f0f0f0f;
+  return (x * 0x01010101) >> 24;
+}
+
 /* Returns the number of elements required for BIT_CNT bits. */
 static inline size_t
 elem_cnt (size_t bit_cnt)
@@ -60,6 +83,39 @@ byte_cnt (size_t bit_cnt)
   return sizeof (elem_type) * elem_cnt (bit_cnt);
 }
 
+/* Calls FUNC(B, IDX, MASK, AUX) for each element IDX of B that
+   holds some of the CNT bits starting at START, with MASK
+   selecting those bits within the element.  Stops early and
+   returns true as soon as FUNC does; otherwise returns false. */
+static inline bool
+for_each_elem (const struct bitmap *b, size_t start, size_t cnt,
+               bool (*func) (const struct bitmap *, size_t idx,
+                             elem_type mask, void *aux),
+               void *aux)
+{
+  size_t end = start + cnt;
+
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      size_t lo = start % ELEM_BITS;
+      size_t hi = end - idx * ELEM_BITS < ELEM_BITS
+                  ? end - idx * ELEM_BITS : ELEM_BITS;
+      if (func (b, idx, range_mask (lo, hi), aux))
+        return true;
+      start = idx * ELEM_BITS + hi;
+    }
+  return false;
+}
+
+/* Lowers B's free hint to IDX, if B keeps one. */
+static inline void
+lower_hint (struct bitmap *b, size_t idx)
+{
+  if (b->use_hint && idx < b->free_hint)
+    b->free_hint = idx;
+}
+
 /* Returns a bit mask in which the bits actually used in the last
    element of B's bits are set to 1 and the rest are set to 0. */
 static inline elem_type
@@ -83,6 +139,8 @@ bitmap_create (size_t bit_cnt)
     {
       b->bit_cnt = bit_cnt;
       b->bits = malloc (byte_cnt (bit_cnt));
+      b->use_hint = false;
+      b->free_hint = 0;
       if (b->bits != NULL || bit_cnt == 0)
         {
           bitmap_set_all (b, false);
@@ -105,6 +163,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->use_hint = false;
+  b->free_hint = 0;
   bitmap_set_all (b, false);
   return b;
 }
@@ -129,6 +189,16 @@ bitmap_destroy (struct bitmap *b)
     }
 }
 
+/* Makes B keep a hint of its lowest possibly-false bit, so that
+   scans for false bits skip the true prefix.  Only for bitmaps
+   whose updates and scans the caller serializes with a lock. */
+void
+bitmap_enable_hint (struct bitmap *b)
+{
+  b->use_hint = true;
+  b->free_hint = 0;
+}
+
 /* Bitmap size. */
 
 /* Returns the number of bits in B. */
@@ -176,6 +246,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  lower_hint (b, bit_idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -191,6 +262,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  lower_hint (b, bit_idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -213,18 +285,45 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
+/* for_each_elem() helper for bitmap_set_multiple(): sets the
+   MASK bits of element IDX to *(bool *) VALUE_. */
+static bool
+set_elem (const struct bitmap *b_, size_t idx, elem_type mask, void *value_)
+{
+  struct bitmap *b = (struct bitmap *) b_;
+  bool value = *(bool *) value_;
+
+  /* Like bitmap_mark() and bitmap_reset(), a single instruction
+     per element keeps each update atomic on a uniprocessor. */
+  if (mask == (elem_type) -1)
+    b->bits[idx] = value ? (elem_type) -1 : 0;
+  else if (value)
+    asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  else
+    asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  return false;
+}
+
 /* Sets the CNT bits starting at START in B to VALUE. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  for_each_elem (b, start, cnt, set_elem, &value);
+  if (!value && cnt > 0)
+    lower_hint (b, start);
+}
+
+/* for_each_elem() helper for bitmap_count(): adds the number of
+   true MASK bits in element IDX to *(size_t *) CNT_. */
+static bool
+count_elem (const struct bitmap *b, size_t idx, elem_type mask, void *cnt_)
+{
+  *(size_t *) cnt_ += popcount (b->bits[idx] & mask);
+  return false;
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,17 +331,24 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t true_cnt = 0;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  for_each_elem (b, start, cnt, count_elem, &true_cnt);
+  return value ? true_cnt : cnt - true_cnt;
+}
+
+/* for_each_elem() helper for bitmap_contains(): returns true if
+   any MASK bit of element IDX is *(bool *) VALUE_. */
+static bool
+contains_elem (const struct bitmap *b, size_t idx, elem_type mask,
+               void *value_)
+{
+  elem_type bits = *(bool *) value_ ? b->bits[idx] : ~b->bits[idx];
+  return (bits & mask) != 0;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -250,16 +356,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return for_each_elem (b, start, cnt, contains_elem, &value);
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -288,6 +389,34 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Returns the index of the first bit at or after START in B that
+   is set to VALUE, or B's bit count if there is none. */
+static size_t
+find_next (const struct bitmap *b, size_t start, bool value)
+{
+  size_t idx = elem_idx (start);
+  size_t last = elem_cnt (b->bit_cnt);
+  elem_type bits;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  /* Invert for false so we always look for a 1-bit, and drop the
+     bits before START in the first element. */
+  bits = (value ? b->bits[idx] : ~b->bits[idx])
+         & ~(((elem_type) 1 << (start % ELEM_BITS)) - 1);
+  while (bits == 0)
+    {
+      if (++idx >= last)
+        return b->bit_cnt;
+      bits = value ? b->bits[idx] : ~b->bits[idx];
+    }
+
+  /* bsf finds the lowest 1-bit. */
+  start = idx * ELEM_BITS + __builtin_ctzl (bits);
+  return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -295,16 +424,35 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
+  struct bitmap *hb = (struct bitmap *) b;
+  bool update_hint;
+  size_t i;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt > b->bit_cnt)
+    return BITMAP_ERROR;
+  if (cnt == 0)
+    return start;
+
+  /* Scanning for false bits from below the hint can start at the
+     hint, and what we find becomes the new hint. */
+  update_hint = b->use_hint && !value && start <= b->free_hint;
+  if (update_hint)
+    start = b->free_hint;
+
+  /* Jump to the next VALUE bit, then to the next !VALUE bit after
+     it: if that is at least CNT bits later, we found a run. */
+  i = find_next (b, start, value);
+  if (update_hint)
+    hb->free_hint = i;
+  while (i + cnt <= b->bit_cnt)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t end = find_next (b, i, !value);
+      if (end >= i + cnt)
+        return i;
+      i = find_next (b, end, value);
     }
   return BITMAP_ERROR;
 }
@@ -346,6 +494,7 @@ bitmap_read (struct bitmap *b, struct file *file)
       off_t size = byte_cnt (b->bit_cnt);
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      b->free_hint = 0;
     }
   return success;
 }
@@ -358,6 +507,23 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the SIZE bytes of B that start at byte offset OFS to the
+   same offset in FILE, stopping at the end of B.  Return true if
+   successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   size_t ofs, size_t size)
+{
+  size_t file_size = byte_cnt (b->bit_cnt);
+
+  if (ofs >= file_size)
+    return true;
+  if (size > file_size - ofs)
+    size = file_size - ofs;
+  return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+         == (off_t) size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
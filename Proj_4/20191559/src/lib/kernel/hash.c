@@ -12,12 +12,14 @@
 #define list_elem_to_hash_elem(LIST_ELEM)                       \
         list_entry(LIST_ELEM, struct hash_elem, list_elem)
 
-static struct list *find_bucket (struct hash *, struct hash_elem *);
+static struct list *find_bucket (struct hash *, unsigned hash);
 static struct hash_elem *find_elem (struct hash *, struct list *,
-                                    struct hash_elem *);
+                                    struct hash_elem *, unsigned hash);
 static void insert_elem (struct hash *, struct list *, struct hash_elem *);
 static void remove_elem (struct hash *, struct hash_elem *);
 static void rehash (struct hash *);
+static void move_buckets (struct hash *, size_t cnt);
+static void finish_rehash (struct hash *);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -28,6 +30,8 @@ hash_init (struct hash *h,
   h->elem_cnt = 0;
   h->bucket_cnt = 4;
   h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+  h->old_buckets = NULL;
+  h->old_bucket_cnt = h->moved_cnt = 0;
   h->hash = hash;
   h->less = less;
   h->aux = aux;
@@ -55,6 +59,7 @@ hash_clear (struct hash *h, hash_action_func *destructor)
 {
   size_t i;
 
+  finish_rehash (h);
   for (i = 0; i < h->bucket_cnt; i++) 
     {
       struct list *bucket = &h->buckets[i];
@@ -88,6 +93,7 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 {
   if (destructor != NULL)
     hash_clear (h, destructor);
+  free (h->old_buckets);
   free (h->buckets);
 }
 
@@ -98,8 +104,9 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 struct hash_elem *
 hash_insert (struct hash *h, struct hash_elem *new)
 {
-  struct list *bucket = find_bucket (h, new);
-  struct hash_elem *old = find_elem (h, bucket, new);
+  unsigned hash = new->hash = h->hash (new, h->aux);
+  struct list *bucket = find_bucket (h, hash);
+  struct hash_elem *old = find_elem (h, bucket, new, hash);
 
   if (old == NULL) 
     insert_elem (h, bucket, new);
@@ -114,8 +121,9 @@ hash_insert (struct hash *h, struct hash_elem *new)
 struct hash_elem *
 hash_replace (struct hash *h, struct hash_elem *new) 
 {
-  struct list *bucket = find_bucket (h, new);
-  struct hash_elem *old = find_elem (h, bucket, new);
+  unsigned hash = new->hash = h->hash (new, h->aux);
+  struct list *bucket = find_bucket (h, hash);
+  struct hash_elem *old = find_elem (h, bucket, new, hash);
 
   if (old != NULL)
     remove_elem (h, old);
@@ -131,7 +139,8 @@ hash_replace (struct hash *h, struct hash_elem *new)
 struct hash_elem *
 hash_find (struct hash *h, struct hash_elem *e) 
 {
-  return find_elem (h, find_bucket (h, e), e);
+  unsigned hash = h->hash (e, h->aux);
+  return find_elem (h, find_bucket (h, hash), e, hash);
 }
 
 /* Finds, removes, and returns an element equal to E in hash
@@ -144,7 +153,8 @@ hash_find (struct hash *h, struct hash_elem *e)
 struct hash_elem *
 hash_delete (struct hash *h, struct hash_elem *e)
 {
-  struct hash_elem *found = find_elem (h, find_bucket (h, e), e);
+  unsigned hash = h->hash (e, h->aux);
+  struct hash_elem *found = find_elem (h, find_bucket (h, hash), e, hash);
   if (found != NULL) 
     {
       remove_elem (h, found);
@@ -166,6 +176,7 @@ hash_apply (struct hash *h, hash_action_func *action)
   
   ASSERT (action != NULL);
 
+  finish_rehash (h);
   for (i = 0; i < h->bucket_cnt; i++) 
     {
       struct list *bucket = &h->buckets[i];
@@ -202,6 +213,7 @@ hash_first (struct hash_iterator *i, struct hash *h)
   ASSERT (i != NULL);
   ASSERT (h != NULL);
 
+  finish_rehash (h);
   i->hash = h;
   i->bucket = i->hash->buckets;
   i->elem = list_elem_to_hash_elem (list_head (i->bucket));
@@ -301,78 +313,81 @@ hash_int (int i)
   return hash_bytes (&i, sizeof i);
 }
 
-/* Returns the bucket in H that E belongs in. */
+/* Returns the bucket in H that elements with hash value HASH
+   belong in.  That is an old bucket, if H is being resized and
+   the old bucket has not been moved yet. */
 static struct list *
-find_bucket (struct hash *h, struct hash_elem *e) 
+find_bucket (struct hash *h, unsigned hash) 
 {
-  size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+  if (h->old_buckets != NULL)
+    {
+      size_t old_idx = hash & (h->old_bucket_cnt - 1);
+      if (old_idx >= h->moved_cnt)
+        return &h->old_buckets[old_idx];
+    }
+  return &h->buckets[hash & (h->bucket_cnt - 1)];
 }
 
-/* Searches BUCKET in H for a hash element equal to E.  Returns
-   it if found or a null pointer otherwise. */
+/* Searches BUCKET in H for a hash element equal to E, whose hash
+   value is HASH.  Returns it if found or a null pointer
+   otherwise. */
 static struct hash_elem *
-find_elem (struct hash *h, struct list *bucket, struct hash_elem *e) 
+find_elem (struct hash *h, struct list *bucket, struct hash_elem *e,
+           unsigned hash) 
 {
   struct list_elem *i;
 
   for (i = list_begin (bucket); i != list_end (bucket); i = list_next (i)) 
     {
       struct hash_elem *hi = list_elem_to_hash_elem (i);
-      if (!h->less (hi, e, h->aux) && !h->less (e, hi, h->aux))
+      if (hi->hash == hash
+          && !h->less (hi, e, h->aux) && !h->less (e, hi, h->aux))
         return hi; 
     }
   return NULL;
 }
 
-/* Returns X with its lowest-order bit set to 1 turned off. */
-static inline size_t
-turn_off_least_1bit (size_t x) 
-{
-  return x & (x - 1);
-}
-
-/* Returns true if X is a power of 2, otherwise false. */
-static inline size_t
-is_power_of_2 (size_t x) 
-{
-  return x != 0 && turn_off_least_1bit (x) == 0;
-}
-
 /* Element per bucket ratios. */
 #define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
 #define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
 #define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
 
-/* Changes the number of buckets in hash table H to match the
-   ideal.  This function can fail because of an out-of-memory
-   condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+/* Old buckets moved by each insertion or deletion while a resize
+   is under way.  Doubling or halving leaves the table at least
+   as many insertions or deletions from the next resize as it now
+   has buckets, and halving leaves twice that many old buckets to
+   move, so moving 2 per operation always finishes in time. */
+#define BUCKETS_PER_STEP 2
+
+/* Moves a few more old buckets if H is being resized, then starts
+   resizing H if its number of elements per bucket has left the
+   range MIN_ELEMS_PER_BUCKET to MAX_ELEMS_PER_BUCKET.  Doubling
+   or halving the bucket count brings it back to about
+   BEST_ELEMS_PER_BUCKET.
+
+   This function can fail because of an out-of-memory condition,
+   but that'll just make hash accesses less efficient; we can
+   still continue. */
 static void
 rehash (struct hash *h) 
 {
-  size_t old_bucket_cnt, new_bucket_cnt;
-  struct list *new_buckets, *old_buckets;
+  size_t new_bucket_cnt;
+  struct list *new_buckets;
   size_t i;
 
   ASSERT (h != NULL);
 
-  /* Save old bucket info for later use. */
-  old_buckets = h->buckets;
-  old_bucket_cnt = h->bucket_cnt;
+  move_buckets (h, BUCKETS_PER_STEP);
 
   /* Calculate the number of buckets to use now.
-     We want one bucket for about every BEST_ELEMS_PER_BUCKET.
      We must have at least four buckets, and the number of
      buckets must be a power of 2. */
-  new_bucket_cnt = h->elem_cnt / BEST_ELEMS_PER_BUCKET;
-  if (new_bucket_cnt < 4)
-    new_bucket_cnt = 4;
-  while (!is_power_of_2 (new_bucket_cnt))
-    new_bucket_cnt = turn_off_least_1bit (new_bucket_cnt);
-
-  /* Don't do anything if the bucket count wouldn't change. */
-  if (new_bucket_cnt == old_bucket_cnt)
+  if (h->elem_cnt > h->bucket_cnt * MAX_ELEMS_PER_BUCKET)
+    new_bucket_cnt = h->bucket_cnt * 2;
+  else if (h->elem_cnt < h->bucket_cnt * MIN_ELEMS_PER_BUCKET
+           && h->bucket_cnt > 4)
+    new_bucket_cnt = h->bucket_cnt / 2;
+  else
     return;
 
   /* Allocate new buckets and initialize them as empty. */
@@ -387,29 +402,51 @@ rehash (struct hash *h)
   for (i = 0; i < new_bucket_cnt; i++) 
     list_init (&new_buckets[i]);
 
-  /* Install new bucket info. */
+  /* Install new bucket info, keeping the current buckets as the
+     old buckets to be moved by this and later calls.  A previous
+     resize should have finished long ago, but make sure. */
+  finish_rehash (h);
+  h->old_buckets = h->buckets;
+  h->old_bucket_cnt = h->bucket_cnt;
+  h->moved_cnt = 0;
   h->buckets = new_buckets;
   h->bucket_cnt = new_bucket_cnt;
 
-  /* Move each old element into the appropriate new bucket. */
-  for (i = 0; i < old_bucket_cnt; i++) 
+  move_buckets (h, BUCKETS_PER_STEP);
+}
+
+/* Moves the elements of up to CNT more old buckets of H into
+   the new buckets, and frees the old buckets once all have been
+   moved.  Does nothing if H is not being resized. */
+static void
+move_buckets (struct hash *h, size_t cnt) 
+{
+  for (; cnt > 0 && h->old_buckets != NULL; cnt--) 
     {
-      struct list *old_bucket;
-      struct list_elem *elem, *next;
+      struct list *old_bucket = &h->old_buckets[h->moved_cnt++];
 
-      old_bucket = &old_buckets[i];
-      for (elem = list_begin (old_bucket);
-           elem != list_end (old_bucket); elem = next) 
+      while (!list_empty (old_bucket)) 
         {
-          struct list *new_bucket
-            = find_bucket (h, list_elem_to_hash_elem (elem));
-          next = list_next (elem);
-          list_remove (elem);
-          list_push_front (new_bucket, elem);
+          struct list_elem *elem = list_pop_front (old_bucket);
+          unsigned hash = list_elem_to_hash_elem (elem)->hash;
+          list_push_front (&h->buckets[hash & (h->bucket_cnt - 1)], elem);
+        }
+
+      if (h->moved_cnt == h->old_bucket_cnt) 
+        {
+          free (h->old_buckets);
+          h->old_buckets = NULL;
         }
     }
+}
 
-  free (old_buckets);
+/* Moves every remaining old bucket of H, completing any resize
+   under way, so that all elements are in H's buckets. */
+static void
+finish_rehash (struct hash *h) 
+{
+  if (h->old_buckets != NULL)
+    move_buckets (h, h->old_bucket_cnt - h->moved_cnt);
 }
 
 /* Inserts E into BUCKET (in hash table H). */
@@ -18,7 +18,20 @@
    conversion from a struct hash_elem back to a structure object
    that contains it.  This is the same technique used in the
    linked list implementation.  Refer to lib/kernel/list.h for a
-   detailed explanation. */
+   detailed explanation.
+
+   Each element caches its hash value, so a search compares
+   elements with the `less' function only when their hash values
+   match, and resizing never calls the hash function.
+
+   The table resizes incrementally.  When it grows or shrinks,
+   the old bucket array is kept, and each later insertion or
+   deletion moves a few of its buckets into the new array, so no
+   single operation pays for moving every element.  Until an old
+   bucket has been moved, searches look there for its elements.
+
+   For maps keyed by a pointer, lib/kernel/ptrmap.h provides an
+   open-addressing table that needs no embedded element. */
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -29,6 +42,7 @@
 struct hash_elem 
   {
     struct list_elem list_elem;
+    unsigned hash;              /* Cached hash value. */
   };
 
 /* Converts pointer to hash element HASH_ELEM into a pointer to
@@ -61,6 +75,9 @@ struct hash
     size_t elem_cnt;            /* Number of elements in table. */
     size_t bucket_cnt;          /* Number of buckets, a power of 2. */
     struct list *buckets;       /* Array of `bucket_cnt' lists. */
+    struct list *old_buckets;   /* Buckets being moved, or null. */
+    size_t old_bucket_cnt;      /* Number of old buckets. */
+    size_t moved_cnt;           /* Old buckets already moved. */
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
@@ -0,0 +1,183 @@
+/* Priority queue ("heap").
+
+   See heap.h for basic information.  This is the pairing heap of
+   Fredman, Sedgewick, Sleator, and Tarjan, "The Pairing Heap: A
+   New Form of Self-Adjusting Heap", Algorithmica 1 (1986), with
+   the two-pass merge done iteratively so that removal uses a
+   fixed amount of kernel stack. */
+
+#include "heap.h"
+#include "../debug.h"
+
+static struct heap_elem *link_roots (struct heap *, struct heap_elem *,
+                               struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes H as an empty heap that orders its elements with
+   LESS, given auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux) 
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->size = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_push (struct heap *h, struct heap_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  h->root = h->root != NULL ? link_roots (h, h->root, e) : e;
+  h->size++;
+}
+
+/* Returns a least element of H, or a null pointer if H is
+   empty. */
+struct heap_elem *
+heap_top (const struct heap *h) 
+{
+  return h->root;
+}
+
+/* Removes and returns a least element of H, or returns a null
+   pointer if H is empty. */
+struct heap_elem *
+heap_pop (struct heap *h) 
+{
+  struct heap_elem *top = h->root;
+
+  if (top != NULL) 
+    {
+      h->root = merge_pairs (h, top->child);
+      h->size--;
+    }
+  return top;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e) 
+{
+  struct heap_elem *sub;
+
+  ASSERT (e != NULL);
+  ASSERT (h->size > 0);
+
+  if (e == h->root) 
+    {
+      heap_pop (h);
+      return;
+    }
+
+  /* Unlink E, with its subtree, from its parent's children. */
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+
+  /* Merge E's children back in. */
+  sub = merge_pairs (h, e->child);
+  if (sub != NULL)
+    h->root = link_roots (h, h->root, sub);
+  h->size--;
+}
+
+/* Moves E, which must be in H, to its proper place in H after
+   its value has changed, in either direction. */
+void
+heap_update (struct heap *h, struct heap_elem *e) 
+{
+  heap_remove (h, e);
+  heap_push (h, e);
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h) 
+{
+  return h->size;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (const struct heap *h) 
+{
+  return h->size == 0;
+}
+
+/* Joins the heaps rooted at A and B, whose siblings are ignored,
+   by making the greater root the first child of the lesser.
+   Returns the root of the result, which has no siblings.  If
+   neither root is less than the other, A stays the root. */
+static struct heap_elem *
+link_roots (struct heap *h, struct heap_elem *a, struct heap_elem *b) 
+{
+  if (h->less (b, a, h->aux)) 
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Joins the heaps rooted at FIRST and its siblings into one and
+   returns its root, or a null pointer if FIRST is null.  Links
+   the roots in pairs from left to right, then links the results
+   from right to left, which gives removal its amortized
+   O(log n) bound. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first) 
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root;
+
+  if (first == NULL)
+    return NULL;
+
+  /* First pass.  PAIRS collects the linked pairs in reverse
+     order, through `next'. */
+  while (first != NULL) 
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      if (b != NULL) 
+        {
+          first = b->next;
+          a = link_roots (h, a, b);
+        }
+      else
+        first = NULL;
+      a->next = pairs;
+      pairs = a;
+    }
+
+  /* Second pass, from the rightmost pair. */
+  root = pairs;
+  pairs = pairs->next;
+  while (pairs != NULL) 
+    {
+      struct heap_elem *next = pairs->next;
+      root = link_roots (h, root, pairs);
+      pairs = next;
+    }
+  root->next = root->prev = NULL;
+  return root;
+}
@@ -0,0 +1,105 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue ("heap").
+
+   A pairing heap: a tree in which no element is less than its
+   parent, under a caller-supplied `less' function, so the root is
+   always a least element.  Inserting an element or reading the
+   least one takes O(1) time, and removing an element takes
+   amortized O(log n) time.
+
+   Like struct list, the heap does not allocate memory.  Each
+   structure that can be in a heap embeds a struct heap_elem
+   member, and heap_entry converts a struct heap_elem back to the
+   structure that contains it:
+
+      struct foo
+        {
+          struct heap_elem elem;
+          int priority;
+          ...other members...
+        };
+
+      static bool
+      foo_higher (const struct heap_elem *a, const struct heap_elem *b,
+                  void *aux UNUSED)
+      {
+        return (heap_entry (a, struct foo, elem)->priority
+                > heap_entry (b, struct foo, elem)->priority);
+      }
+
+      struct heap foo_heap;
+
+      heap_init (&foo_heap, foo_higher, NULL);
+      ...
+      while (!heap_empty (&foo_heap))
+        {
+          struct foo *f = heap_entry (heap_pop (&foo_heap),
+                                      struct foo, elem);
+          ...f has the highest priority left...
+        }
+
+   Unlike rb_insert(), the heap does not keep equal elements in
+   the order they were inserted.  Break ties in the `less'
+   function, with a sequence number, for example, if that order
+   matters.
+
+   Each element's children form a list linked through `next'.
+   An element's `prev' points to its left sibling, or to its
+   parent if it is the first child, which lets heap_remove() take
+   an element out of the middle of the heap. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem 
+  {
+    struct heap_elem *child;    /* First child, or null. */
+    struct heap_elem *next;     /* Next sibling, or null. */
+    struct heap_elem *prev;     /* Previous sibling or parent, or null. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element.  See the big comment at the top of the
+   file for an example. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)                   \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child            \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, that
+   is, if A should come out of the heap first, or false if A is
+   greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap 
+  {
+    struct heap_elem *root;     /* A least element, or null if empty. */
+    size_t size;                /* Number of elements. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Basic life cycle. */
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+/* Insertion and removal. */
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_top (const struct heap *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+/* Information. */
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
@@ -0,0 +1,201 @@
+/* Pointer map.
+
+   See ptrmap.h for basic information. */
+
+#include "ptrmap.h"
+#include <stdint.h>
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Smallest number of slots. */
+#define MIN_SLOT_CNT 16
+
+static size_t home_slot (const struct ptrmap *, const void *key);
+static size_t find_slot (const struct ptrmap *, const void *key);
+static bool resize (struct ptrmap *, size_t slot_cnt);
+
+/* Initializes M as an empty pointer map.  Returns true if
+   successful, false if memory is not available. */
+bool
+ptrmap_init (struct ptrmap *m) 
+{
+  m->cnt = m->slot_cnt = 0;
+  m->slots = NULL;
+  return resize (m, MIN_SLOT_CNT);
+}
+
+/* Destroys pointer map M.
+
+   If DESTRUCTOR is non-null, then it is first called with AUX
+   for each key and its value.  DESTRUCTOR may, if appropriate,
+   deallocate the value, but it must not modify M. */
+void
+ptrmap_destroy (struct ptrmap *m, ptrmap_action_func *destructor, void *aux) 
+{
+  if (destructor != NULL)
+    ptrmap_apply (m, destructor, aux);
+  free (m->slots);
+  m->slots = NULL;
+  m->cnt = m->slot_cnt = 0;
+}
+
+/* Returns the value of KEY in M, or a null pointer if KEY is
+   not in M. */
+void *
+ptrmap_find (const struct ptrmap *m, const void *key) 
+{
+  size_t i = find_slot (m, key);
+  return m->slots[i].key != NULL ? m->slots[i].value : NULL;
+}
+
+/* Maps KEY to VALUE in M.  Returns true if successful, false if
+   KEY is already in M or if memory is not available to grow M. */
+bool
+ptrmap_insert (struct ptrmap *m, const void *key, void *value) 
+{
+  size_t i;
+
+  ASSERT (key != NULL);
+
+  i = find_slot (m, key);
+  if (m->slots[i].key != NULL)
+    return false;
+
+  /* Keep at least a quarter of the slots free, so that probe
+     sequences stay short. */
+  if ((m->cnt + 1) * 4 > m->slot_cnt * 3)
+    {
+      if (!resize (m, m->slot_cnt * 2))
+        return false;
+      i = find_slot (m, key);
+    }
+
+  m->slots[i].key = key;
+  m->slots[i].value = value;
+  m->cnt++;
+  return true;
+}
+
+/* Removes KEY from M and returns its value.  Returns a null
+   pointer if KEY is not in M. */
+void *
+ptrmap_delete (struct ptrmap *m, const void *key) 
+{
+  size_t mask = m->slot_cnt - 1;
+  size_t i = find_slot (m, key);
+  size_t j;
+  void *value;
+
+  if (m->slots[i].key == NULL)
+    return NULL;
+  value = m->slots[i].value;
+  m->slots[i].key = NULL;
+  m->cnt--;
+
+  /* Close the gap at I: move back each following key that could
+     not be found past a free slot at I.  This keeps every key
+     reachable from its home slot without "deleted" markers. */
+  for (j = (i + 1) & mask; m->slots[j].key != NULL; j = (j + 1) & mask) 
+    {
+      size_t home = home_slot (m, m->slots[j].key);
+
+      /* The key at J may stay if its home lies cyclically in
+         (I, J]. */
+      if (i <= j ? i < home && home <= j : i < home || home <= j)
+        continue;
+      m->slots[i] = m->slots[j];
+      m->slots[j].key = NULL;
+      i = j;
+    }
+
+  /* Shrinking can only fail for lack of memory, in which case
+     the map just stays larger than needed. */
+  if (m->slot_cnt > MIN_SLOT_CNT && m->cnt * 8 < m->slot_cnt)
+    resize (m, m->slot_cnt / 2);
+  return value;
+}
+
+/* Calls ACTION with AUX for each key in M and its value, in
+   arbitrary order.  ACTION must not modify M. */
+void
+ptrmap_apply (struct ptrmap *m, ptrmap_action_func *action, void *aux) 
+{
+  size_t i;
+
+  ASSERT (action != NULL);
+
+  for (i = 0; i < m->slot_cnt; i++)
+    if (m->slots[i].key != NULL)
+      action (m->slots[i].key, m->slots[i].value, aux);
+}
+
+/* Returns the number of keys in M. */
+size_t
+ptrmap_size (const struct ptrmap *m) 
+{
+  return m->cnt;
+}
+
+/* Returns the slot that KEY hashes to in M.
+
+   This is Fibonacci hashing: multiplying by 2**32 divided by the
+   golden ratio mixes every bit of KEY into the high bits of the
+   product, which we use.  Keys that differ only in high bits, such
+   as page-aligned addresses, still spread over all the slots. */
+static size_t
+home_slot (const struct ptrmap *m, const void *key) 
+{
+  return ((uint32_t) (uintptr_t) key * 0x9e3779b9u) >> m->shift;
+}
+
+/* Returns the slot that holds KEY in M, or the free slot that
+   ends KEY's probe sequence if KEY is not in M. */
+static size_t
+find_slot (const struct ptrmap *m, const void *key) 
+{
+  size_t mask = m->slot_cnt - 1;
+  size_t i;
+
+  for (i = home_slot (m, key); m->slots[i].key != NULL; i = (i + 1) & mask)
+    if (m->slots[i].key == key)
+      break;
+  return i;
+}
+
+/* Moves the keys in M into a new array of SLOT_CNT slots, which
+   must be a power of 2.  Returns true if successful, false if
+   memory is not available, in which case M is unchanged. */
+static bool
+resize (struct ptrmap *m, size_t slot_cnt) 
+{
+  struct ptrmap_slot *old_slots = m->slots;
+  size_t old_slot_cnt = m->slot_cnt;
+  struct ptrmap_slot *slots;
+  unsigned bits;
+  size_t i;
+
+  ASSERT (slot_cnt >= MIN_SLOT_CNT && (slot_cnt & (slot_cnt - 1)) == 0);
+
+  slots = malloc (sizeof *slots * slot_cnt);
+  if (slots == NULL)
+    return false;
+  for (i = 0; i < slot_cnt; i++)
+    slots[i].key = NULL;
+
+  for (bits = 0; ((size_t) 1 << bits) < slot_cnt; bits++)
+    continue;
+  m->slots = slots;
+  m->slot_cnt = slot_cnt;
+  m->shift = 32 - bits;
+  m->cnt = 0;
+
+  for (i = 0; i < old_slot_cnt; i++)
+    if (old_slots[i].key != NULL)
+      {
+        size_t j = find_slot (m, old_slots[i].key);
+        m->slots[j] = old_slots[i];
+        m->cnt++;
+      }
+  free (old_slots);
+  return true;
+}
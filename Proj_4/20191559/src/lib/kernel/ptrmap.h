@@ -0,0 +1,57 @@
+#ifndef __LIB_KERNEL_PTRMAP_H
+#define __LIB_KERNEL_PTRMAP_H
+
+/* Pointer map.
+
+   A hash table that maps nonnull pointer keys, such as user
+   virtual addresses, to pointer values.  Unlike struct hash, it
+   uses open addressing: keys and values are stored in one array
+   of slots, and a key that collides goes in the next free slot
+   after the one it hashes to ("linear probing").  A search reads
+   neighbouring slots instead of following list pointers through
+   the elements, and the values need not embed any member.
+
+   The table is resized all at once when it becomes 3/4 full or
+   drops below 1/8 full, so a few insertions or deletions take
+   time proportional to the size of the map.  Use struct hash
+   where such a pause matters more than the speed of a search. */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A slot in a pointer map. */
+struct ptrmap_slot
+  {
+    const void *key;            /* Key, or null if slot is free. */
+    void *value;                /* Value. */
+  };
+
+/* Pointer map. */
+struct ptrmap
+  {
+    size_t cnt;                 /* Number of keys in map. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    unsigned shift;             /* 32 - log2 (slot_cnt). */
+    struct ptrmap_slot *slots;  /* Array of `slot_cnt' slots. */
+  };
+
+/* Performs some operation on the value VALUE of key KEY, given
+   auxiliary data AUX. */
+typedef void ptrmap_action_func (const void *key, void *value, void *aux);
+
+/* Basic life cycle. */
+bool ptrmap_init (struct ptrmap *);
+void ptrmap_destroy (struct ptrmap *, ptrmap_action_func *, void *aux);
+
+/* Search, insertion, deletion. */
+void *ptrmap_find (const struct ptrmap *, const void *key);
+bool ptrmap_insert (struct ptrmap *, const void *key, void *value);
+void *ptrmap_delete (struct ptrmap *, const void *key);
+
+/* Iteration. */
+void ptrmap_apply (struct ptrmap *, ptrmap_action_func *, void *aux);
+
+/* Information. */
+size_t ptrmap_size (const struct ptrmap *);
+
+#endif /* lib/kernel/ptrmap.h */
@@ -0,0 +1,436 @@
+/* Red-black tree.
+
+   See rbtree.h for basic information.  The algorithms follow
+   Cormen, Leiserson, Rivest, and Stein, _Introduction to
+   Algorithms_, chapter 13, with null pointers instead of a
+   sentinel leaf, so removal carries the parent of the node it is
+   fixing up. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void replace_child (struct rb_tree *, struct rb_elem *parent,
+                           struct rb_elem *old, struct rb_elem *new);
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+                          struct rb_elem *parent);
+
+/* Returns true if E is a red node, false if it is black or a
+   null leaf. */
+static inline bool
+is_red (const struct rb_elem *e) 
+{
+  return e != NULL && e->red;
+}
+
+/* Initializes T as an empty tree that orders its elements with
+   LESS, given auxiliary data AUX. */
+void
+rb_init (struct rb_tree *t, rb_less_func *less, void *aux) 
+{
+  ASSERT (t != NULL);
+  ASSERT (less != NULL);
+
+  t->root = t->min = NULL;
+  t->size = 0;
+  t->less = less;
+  t->aux = aux;
+}
+
+/* Inserts E into T, after any elements equal to it. */
+void
+rb_insert (struct rb_tree *t, struct rb_elem *e) 
+{
+  struct rb_elem *parent = NULL;
+  struct rb_elem **link = &t->root;
+  bool leftmost = true;
+
+  ASSERT (e != NULL);
+
+  while (*link != NULL) 
+    {
+      parent = *link;
+      if (t->less (e, parent, t->aux))
+        link = &parent->left;
+      else
+        {
+          link = &parent->right;
+          leftmost = false;
+        }
+    }
+
+  e->parent = parent;
+  e->left = e->right = NULL;
+  e->red = true;
+  *link = e;
+  if (leftmost)
+    t->min = e;
+  t->size++;
+
+  insert_fixup (t, e);
+}
+
+/* Removes E, which must be in T, from T. */
+void
+rb_remove (struct rb_tree *t, struct rb_elem *e) 
+{
+  struct rb_elem *child, *parent;
+  bool removed_red;
+
+  ASSERT (e != NULL);
+  ASSERT (t->size > 0);
+
+  if (t->min == e)
+    t->min = rb_next (e);
+
+  if (e->left == NULL || e->right == NULL) 
+    {
+      /* E has at most one child, which takes its place. */
+      child = e->left != NULL ? e->left : e->right;
+      parent = e->parent;
+      removed_red = e->red;
+      if (child != NULL)
+        child->parent = parent;
+      replace_child (t, parent, e, child);
+    }
+  else 
+    {
+      /* E's successor S, which has no left child, takes E's
+         place and color, and S's right child takes S's old
+         place. */
+      struct rb_elem *s = e->right;
+
+      while (s->left != NULL)
+        s = s->left;
+      child = s->right;
+      removed_red = s->red;
+      if (s->parent == e)
+        parent = s;
+      else 
+        {
+          parent = s->parent;
+          parent->left = child;
+          if (child != NULL)
+            child->parent = parent;
+          s->right = e->right;
+          s->right->parent = s;
+        }
+      s->left = e->left;
+      s->left->parent = s;
+      s->parent = e->parent;
+      s->red = e->red;
+      replace_child (t, e->parent, e, s);
+    }
+  t->size--;
+
+  /* Removing a black node leaves the paths through CHILD one
+     black node short. */
+  if (!removed_red)
+    remove_fixup (t, child, parent);
+}
+
+/* Removes and returns the smallest element in T, or returns a
+   null pointer if T is empty. */
+struct rb_elem *
+rb_pop_min (struct rb_tree *t) 
+{
+  struct rb_elem *e = t->min;
+
+  if (e != NULL)
+    rb_remove (t, e);
+  return e;
+}
+
+/* Returns the first element in T equal to E, or a null pointer
+   if no element in T is equal to E. */
+struct rb_elem *
+rb_find (const struct rb_tree *t, const struct rb_elem *e) 
+{
+  struct rb_elem *found = rb_lower_bound (t, e);
+
+  return found != NULL && !t->less (e, found, t->aux) ? found : NULL;
+}
+
+/* Returns the first element in T that is not less than E, or a
+   null pointer if every element in T is less than E. */
+struct rb_elem *
+rb_lower_bound (const struct rb_tree *t, const struct rb_elem *e) 
+{
+  struct rb_elem *node = t->root;
+  struct rb_elem *found = NULL;
+
+  while (node != NULL)
+    if (t->less (node, e, t->aux))
+      node = node->right;
+    else 
+      {
+        found = node;
+        node = node->left;
+      }
+  return found;
+}
+
+/* Returns the smallest element in T, or a null pointer if T is
+   empty.  Of equal elements, returns the first inserted. */
+struct rb_elem *
+rb_min (const struct rb_tree *t) 
+{
+  return t->min;
+}
+
+/* Returns the largest element in T, or a null pointer if T is
+   empty. */
+struct rb_elem *
+rb_max (const struct rb_tree *t) 
+{
+  struct rb_elem *e = t->root;
+
+  if (e != NULL)
+    while (e->right != NULL)
+      e = e->right;
+  return e;
+}
+
+/* Returns the element after E in its tree, or a null pointer if
+   E is the largest. */
+struct rb_elem *
+rb_next (const struct rb_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  if (e->right != NULL) 
+    {
+      e = e->right;
+      while (e->left != NULL)
+        e = e->left;
+      return (struct rb_elem *) e;
+    }
+  while (e->parent != NULL && e == e->parent->right)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the element before E in its tree, or a null pointer if
+   E is the smallest. */
+struct rb_elem *
+rb_prev (const struct rb_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  if (e->left != NULL) 
+    {
+      e = e->left;
+      while (e->right != NULL)
+        e = e->right;
+      return (struct rb_elem *) e;
+    }
+  while (e->parent != NULL && e == e->parent->left)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t
+rb_size (const struct rb_tree *t) 
+{
+  return t->size;
+}
+
+/* Returns true if T is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *t) 
+{
+  return t->size == 0;
+}
+
+/* Makes NEW take the place of OLD as the child of PARENT in T,
+   or as T's root if PARENT is null. */
+static void
+replace_child (struct rb_tree *t, struct rb_elem *parent,
+               struct rb_elem *old, struct rb_elem *new) 
+{
+  if (parent == NULL)
+    t->root = new;
+  else if (parent->left == old)
+    parent->left = new;
+  else
+    parent->right = new;
+}
+
+/* Rotates the subtree at X left in T, so that X's right child
+   takes X's place and X becomes its left child. */
+static void
+rotate_left (struct rb_tree *t, struct rb_elem *x) 
+{
+  struct rb_elem *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  y->parent = x->parent;
+  replace_child (t, x->parent, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+/* Rotates the subtree at X right in T, so that X's left child
+   takes X's place and X becomes its right child. */
+static void
+rotate_right (struct rb_tree *t, struct rb_elem *x) 
+{
+  struct rb_elem *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  y->parent = x->parent;
+  replace_child (t, x->parent, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/* Restores the red-black properties of T after red node E has
+   been inserted, where E's parent may also be red. */
+static void
+insert_fixup (struct rb_tree *t, struct rb_elem *e) 
+{
+  struct rb_elem *p;
+
+  while (is_red (p = e->parent)) 
+    {
+      /* P is red, so it is not the root and has a parent. */
+      struct rb_elem *g = p->parent;
+
+      if (p == g->left) 
+        {
+          struct rb_elem *u = g->right;
+
+          if (is_red (u)) 
+            {
+              /* Red uncle: push G's blackness down, then
+                 continue from G. */
+              p->red = u->red = false;
+              g->red = true;
+              e = g;
+              continue;
+            }
+          if (e == p->right) 
+            {
+              rotate_left (t, p);
+              e = p;
+              p = e->parent;
+            }
+          p->red = false;
+          g->red = true;
+          rotate_right (t, g);
+        }
+      else 
+        {
+          struct rb_elem *u = g->left;
+
+          if (is_red (u)) 
+            {
+              p->red = u->red = false;
+              g->red = true;
+              e = g;
+              continue;
+            }
+          if (e == p->left) 
+            {
+              rotate_right (t, p);
+              e = p;
+              p = e->parent;
+            }
+          p->red = false;
+          g->red = true;
+          rotate_left (t, g);
+        }
+    }
+  t->root->red = false;
+}
+
+/* Restores the red-black properties of T after a black node was
+   removed from the place now held by X, a child of PARENT, so
+   that paths through X are one black node short.  X may be a
+   null leaf. */
+static void
+remove_fixup (struct rb_tree *t, struct rb_elem *x, struct rb_elem *parent) 
+{
+  while (x != t->root && !is_red (x)) 
+    {
+      /* X's side is short a black node, so its sibling W has at
+         least one black node below it and is not null. */
+      if (x == parent->left) 
+        {
+          struct rb_elem *w = parent->right;
+
+          if (w->red) 
+            {
+              w->red = false;
+              parent->red = true;
+              rotate_left (t, parent);
+              w = parent->right;
+            }
+          if (!is_red (w->left) && !is_red (w->right)) 
+            {
+              /* Take a black node off W's side too, and move the
+                 shortfall up to PARENT. */
+              w->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else 
+            {
+              if (!is_red (w->right)) 
+                {
+                  w->left->red = false;
+                  w->red = true;
+                  rotate_right (t, w);
+                  w = parent->right;
+                }
+              w->red = parent->red;
+              parent->red = false;
+              w->right->red = false;
+              rotate_left (t, parent);
+              x = t->root;
+            }
+        }
+      else 
+        {
+          struct rb_elem *w = parent->left;
+
+          if (w->red) 
+            {
+              w->red = false;
+              parent->red = true;
+              rotate_right (t, parent);
+              w = parent->left;
+            }
+          if (!is_red (w->left) && !is_red (w->right)) 
+            {
+              w->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else 
+            {
+              if (!is_red (w->left)) 
+                {
+                  w->right->red = false;
+                  w->red = true;
+                  rotate_left (t, w);
+                  w = parent->left;
+                }
+              w->red = parent->red;
+              parent->red = false;
+              w->left->red = false;
+              rotate_right (t, parent);
+              x = t->root;
+            }
+        }
+    }
+  if (x != NULL)
+    x->red = false;
+}
@@ -0,0 +1,113 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A balanced binary search tree that keeps its elements sorted
+   under a caller-supplied `less' function.  Insertion, removal,
+   and search take O(log n) time; the smallest element is cached,
+   so rb_min() takes O(1), and stepping to the next or previous
+   element takes amortized O(1).
+
+   Like struct list and struct hash, the tree does not allocate
+   memory.  Each structure that can be in a tree embeds a struct
+   rb_elem member, and rb_entry converts a struct rb_elem back to
+   the structure that contains it:
+
+      struct foo
+        {
+          struct rb_elem elem;
+          int key;
+          ...other members...
+        };
+
+      static bool
+      foo_less (const struct rb_elem *a, const struct rb_elem *b,
+                void *aux UNUSED)
+      {
+        return (rb_entry (a, struct foo, elem)->key
+                < rb_entry (b, struct foo, elem)->key);
+      }
+
+      struct rb_tree foo_tree;
+      struct rb_elem *e;
+
+      rb_init (&foo_tree, foo_less, NULL);
+      ...
+      for (e = rb_min (&foo_tree); e != NULL; e = rb_next (e))
+        {
+          struct foo *f = rb_entry (e, struct foo, elem);
+          ...do something with f...
+        }
+
+   Equal elements are allowed.  A new element goes after every
+   element equal to it, so equal elements come out in the order
+   they were inserted, as with list_insert_ordered().
+
+   Every node is red or black.  The root and the null leaves are
+   black, a red node has no red child, and every path from a
+   node down to a leaf passes through the same number of black
+   nodes.  Together these keep the longest path no more than
+   twice the shortest, so the height is at most 2 log2 (n + 1). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem 
+  {
+    struct rb_elem *parent;     /* Parent, or null for the root. */
+    struct rb_elem *left;       /* Left child, or null. */
+    struct rb_elem *right;      /* Right child, or null. */
+    bool red;                   /* True if red, false if black. */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element.  See the big comment at the top of the file for
+   an example. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                       \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent             \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree 
+  {
+    struct rb_elem *root;       /* Root, or null if empty. */
+    struct rb_elem *min;        /* Smallest element, or null if empty. */
+    size_t size;                /* Number of elements. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Basic life cycle. */
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Insertion, removal, search. */
+void rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+struct rb_elem *rb_pop_min (struct rb_tree *);
+struct rb_elem *rb_find (const struct rb_tree *, const struct rb_elem *);
+struct rb_elem *rb_lower_bound (const struct rb_tree *,
+                                const struct rb_elem *);
+
+/* Traversal. */
+struct rb_elem *rb_min (const struct rb_tree *);
+struct rb_elem *rb_max (const struct rb_tree *);
+struct rb_elem *rb_next (const struct rb_elem *);
+struct rb_elem *rb_prev (const struct rb_elem *);
+
+/* Information. */
+size_t rb_size (const struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
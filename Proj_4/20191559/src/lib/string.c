@@ -1,5 +1,87 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* string.h expands calls with small constant sizes inline.
+   Here we define the out-of-line functions themselves. */
+#undef memcpy
+#undef memset
+
+/* The block functions below move, fill, and compare a 32-bit
+   word at a time.  Blocks shorter than WORD_MIN bytes are not
+   worth the setup, so they are handled a byte at a time. */
+#define WORD_MIN 16
+
+/* A word that may alias any other type, so that it can be used
+   to read and write blocks of arbitrary type. */
+typedef uint32_t word_t __attribute__ ((may_alias));
+
+/* Returns nonzero if word W contains a zero byte. */
+static inline word_t
+has_zero_byte (word_t w)
+{
+  return (w - 0x01010101u) & ~w & 0x80808080u;
+}
+
+/* Copies SIZE bytes from SRC to DST in ascending address order.
+   Safe if DST and SRC overlap and DST is below SRC.
+
+   Leading bytes are copied one at a time until DST is word
+   aligned, then "rep movsl" copies whole words.  The direction
+   flag is always clear here: the ABI requires it at function
+   entry and intr_entry clears it on every interrupt. */
+static inline void
+copy_up (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  if (size >= WORD_MIN)
+    {
+      size_t head = -(uintptr_t) dst % sizeof (word_t);
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = *src++;
+
+      words = size / sizeof (word_t);
+      size %= sizeof (word_t);
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
+  while (size-- > 0)
+    *dst++ = *src++;
+}
+
+/* Copies SIZE bytes from SRC to DST in descending address order.
+   Safe if DST and SRC overlap and DST is above SRC. */
+static inline void
+copy_down (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  dst += size;
+  src += size;
+  if (size >= WORD_MIN)
+    {
+      size_t tail = (uintptr_t) dst % sizeof (word_t);
+      size_t words;
+
+      size -= tail;
+      while (tail-- > 0)
+        *--dst = *--src;
+
+      /* With the direction flag set, "rep movsl" starts at the
+         highest word and works down.  Clear the flag again before
+         anything else can run string instructions. */
+      words = size / sizeof (word_t);
+      size %= sizeof (word_t);
+      dst -= sizeof (word_t);
+      src -= sizeof (word_t);
+      asm volatile ("std; rep movsl; cld"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+      dst += sizeof (word_t);
+      src += sizeof (word_t);
+    }
+  while (size-- > 0)
+    *--dst = *--src;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,8 +94,7 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
+  copy_up (dst, src, size);
 
   return dst_;
 }
@@ -30,19 +111,11 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (src != NULL || size == 0);
 
   if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
-    {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
-    }
+    copy_up (dst, src, size);
+  else if (dst > src)
+    copy_down (dst, src, size);
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +131,17 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip equal words, then find the differing byte.  x86 allows
+     unaligned loads, so A and B need not be aligned. */
+  if (size >= WORD_MIN)
+    while (size >= sizeof (word_t)
+           && *(const word_t *) a == *(const word_t *) b)
+      {
+        a += sizeof (word_t);
+        b += sizeof (word_t);
+        size -= sizeof (word_t);
+      }
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -282,6 +366,21 @@ memset (void *dst_, int value, size_t size)
 
   ASSERT (dst != NULL || size == 0);
   
+  if (size >= WORD_MIN)
+    {
+      word_t pattern = (unsigned char) value * 0x01010101u;
+      size_t head = -(uintptr_t) dst % sizeof (word_t);
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = value;
+
+      words = size / sizeof (word_t);
+      size %= sizeof (word_t);
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words) : "a" (pattern) : "memory");
+    }
   while (size-- > 0)
     *dst++ = value;
 
@@ -293,10 +392,19 @@ size_t
 strlen (const char *string) 
 {
   const char *p;
+  const word_t *w;
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
+  /* Check bytes up to a word boundary, then whole words.  An
+     aligned word never crosses a page boundary, so reading past
+     the null terminator cannot fault. */
+  for (p = string; (uintptr_t) p % sizeof (word_t) != 0; p++)
+    if (*p == '\0')
+      return p - string;
+  for (w = (const word_t *) p; !has_zero_byte (*w); w++)
+    continue;
+  for (p = (const char *) w; *p != '\0'; p++)
     continue;
   return p - string;
 }
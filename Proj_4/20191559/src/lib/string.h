@@ -25,6 +25,20 @@ size_t strlcat (char *, const char *, size_t);
 char *strtok_r (char *, const char *, char **);
 size_t strnlen (const char *, size_t);
 
+/* Copies and fills of at most this many bytes, if the size is a
+   compile-time constant, are expanded inline into a few moves
+   instead of calling the word-at-a-time functions, whose setup
+   would dominate.  This covers the structure copies and small
+   buffer clears that make up most calls. */
+#define __STRING_INLINE_MAX 16
+
+#define memcpy(DST, SRC, SIZE)                                          \
+        (__builtin_constant_p (SIZE) && (SIZE) <= __STRING_INLINE_MAX   \
+         ? __builtin_memcpy (DST, SRC, SIZE) : memcpy (DST, SRC, SIZE))
+#define memset(DST, VALUE, SIZE)                                        \
+        (__builtin_constant_p (SIZE) && (SIZE) <= __STRING_INLINE_MAX   \
+         ? __builtin_memset (DST, VALUE, SIZE) : memset (DST, VALUE, SIZE))
+
 /* Try to be helpful. */
 #define strcpy dont_use_strcpy_use_strlcpy
 #define strncpy dont_use_strncpy_use_strlcpy
@@ -0,0 +1,53 @@
+/* Child process for syn-par test.
+   Writes its own test file a chunk at a time, then reads it back
+   ROUND_CNT times and checks the contents, while the other
+   children do the same with their files. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-par.h"
+
+static char buf[BUF_SIZE];
+static char chunk[CHUNK_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  int child_idx;
+  int fd;
+  size_t ofs;
+  int round;
+
+  test_name = "child-syn-par";
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "par%d", child_idx);
+
+  random_init (child_idx);
+  random_bytes (buf, sizeof buf);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < BUF_SIZE; ofs += CHUNK_SIZE)
+    CHECK (write (fd, buf + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+           "write \"%s\"", file_name);
+
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < BUF_SIZE; ofs += CHUNK_SIZE)
+        {
+          CHECK (read (fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+                 "read \"%s\"", file_name);
+          compare_bytes (chunk, buf + ofs, CHUNK_SIZE, ofs, file_name);
+        }
+    }
+  close (fd);
+
+  return child_idx;
+}
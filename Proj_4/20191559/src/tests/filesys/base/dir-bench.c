@@ -0,0 +1,91 @@
+/* Creates FILE_CNT empty files in the root directory and times
+   name lookups as the directory grows.
+
+   At each checkpoint, opens and closes LOOKUP_CNT of the files
+   created so far, timing each open with the CPU's time-stamp
+   counter, and reports the average.  Opening a file looks its
+   name up in the directory, so a hashed directory keeps the
+   average about the same from the first checkpoint to the last,
+   where a linear scan would grow with the number of entries.
+   The cycle counts depend on the machine, so only the file
+   operations themselves can fail. */
+
+#include <syscall.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10000          /* Files created in all. */
+#define LOOKUP_CNT 500          /* Opens timed per checkpoint. */
+
+/* Numbers of files at which to time lookups. */
+static const int checkpoints[] = {100, 1000, FILE_CNT};
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+read_tsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Stores the name of file number I in NAME. */
+static void
+make_name (char name[16], int i) 
+{
+  snprintf (name, 16, "f%d", i);
+}
+
+void
+test_main (void) 
+{
+  char name[16];
+  int created = 0;
+  size_t i;
+  int j;
+
+  for (i = 0; i < sizeof checkpoints / sizeof *checkpoints; i++) 
+    {
+      uint64_t cycles = 0;
+
+      msg ("creating \"f%d\" through \"f%d\"", created, checkpoints[i] - 1);
+      quiet = true;
+      for (; created < checkpoints[i]; created++) 
+        {
+          make_name (name, created);
+          CHECK (create (name, 0), "create \"%s\"", name);
+        }
+
+      /* Visit the files in a scattered order, so that the lookups
+         do not just follow the order of creation. */
+      for (j = 0; j < LOOKUP_CNT; j++) 
+        {
+          uint64_t start;
+          int fd;
+
+          make_name (name, (int) ((j * 7919u) % created));
+          start = read_tsc ();
+          fd = open (name);
+          cycles += read_tsc () - start;
+          CHECK (fd > 1, "open \"%s\"", name);
+          close (fd);
+        }
+      quiet = false;
+      msg ("%d entries: average open %llu cycles",
+           created, cycles / LOOKUP_CNT);
+    }
+
+  CHECK (open ("g0") == -1, "open \"g0\" (must return -1)");
+
+  msg ("removing all files");
+  quiet = true;
+  for (j = 0; j < FILE_CNT; j++) 
+    {
+      make_name (name, j);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+  CHECK (open ("f0") == -1, "open \"f0\" (must return -1)");
+}
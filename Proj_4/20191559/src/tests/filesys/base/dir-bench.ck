@@ -0,0 +1,38 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+my (@expected) = ('(dir-bench) begin',
+                  '(dir-bench) creating "f0" through "f99"',
+                  'ENTRIES 100',
+                  '(dir-bench) creating "f100" through "f999"',
+                  'ENTRIES 1000',
+                  '(dir-bench) creating "f1000" through "f9999"',
+                  'ENTRIES 10000',
+                  '(dir-bench) open "g0" (must return -1)',
+                  '(dir-bench) removing all files',
+                  '(dir-bench) open "f0" (must return -1)',
+                  '(dir-bench) end');
+fail "expected " . scalar (@expected) . " lines of output, got "
+  . scalar (@output) . "\n" . join ("\n", @output) . "\n"
+  if @output != @expected;
+for my $i (0..$#expected) {
+    my ($want) = $expected[$i];
+    my ($got) = $output[$i];
+    if ($want =~ /^ENTRIES (\d+)$/) {
+	fail "line " . ($i + 1) . ": expected open timing for $1 entries, "
+	  . "got \"$got\"\n"
+	  unless $got =~ /^\(dir-bench\) $1 entries: average open \d+ cycles$/;
+    } else {
+	fail "line " . ($i + 1) . ": expected \"$want\", got \"$got\"\n"
+	  if $got ne $want;
+    }
+}
+pass;
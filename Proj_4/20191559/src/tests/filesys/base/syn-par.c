@@ -0,0 +1,29 @@
+/* Creates one file per child process, then spawns the children,
+   which all write and read back their own files at the same
+   time.  I/O on different files should proceed in parallel; the
+   kernel's "Inode:" statistics report how many reads and writes
+   were in progress at once, and the "Timer:" line the total
+   time. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/base/syn-par.h"
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  size_t i;
+
+  for (i = 0; i < CHILD_CNT; i++) 
+    {
+      char file_name[16];
+      snprintf (file_name, sizeof file_name, "par%zu", i);
+      CHECK (create (file_name, BUF_SIZE), "create \"%s\"", file_name);
+    }
+
+  exec_children ("child-syn-par", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-par) begin
+(syn-par) create "par0"
+(syn-par) create "par1"
+(syn-par) create "par2"
+(syn-par) create "par3"
+(syn-par) exec child 1 of 4: "child-syn-par 0"
+(syn-par) exec child 2 of 4: "child-syn-par 1"
+(syn-par) exec child 3 of 4: "child-syn-par 2"
+(syn-par) exec child 4 of 4: "child-syn-par 3"
+(syn-par) wait for child 1 of 4 returned 0 (expected 0)
+(syn-par) wait for child 2 of 4 returned 1 (expected 1)
+(syn-par) wait for child 3 of 4 returned 2 (expected 2)
+(syn-par) wait for child 4 of 4 returned 3 (expected 3)
+(syn-par) end
+EOF
+pass;
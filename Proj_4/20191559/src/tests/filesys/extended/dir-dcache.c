@@ -0,0 +1,40 @@
+/* Checks that lookups follow changes to the names they have
+   already seen: a name that was not found can then be created,
+   a removed name is gone, and ".." in a directory made after
+   another one was removed names its own parent. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd, p_fd;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (open ("a/b") == -1, "open \"a/b\" (must return -1)");
+  CHECK (create ("a/b", 0), "create \"a/b\"");
+  CHECK ((fd = open ("a/b")) > 1, "open \"a/b\"");
+  msg ("close \"a/b\"");
+  close (fd);
+  CHECK (remove ("a/b"), "remove \"a/b\"");
+  CHECK (open ("a/b") == -1, "open \"a/b\" (must return -1)");
+
+  CHECK ((fd = open ("a/..")) > 1, "open \"a/..\"");
+  msg ("close \"a/..\"");
+  close (fd);
+  CHECK (remove ("a"), "rmdir \"a\"");
+  CHECK (open ("a/..") == -1, "open \"a/..\" (must return -1)");
+
+  CHECK (mkdir ("p"), "mkdir \"p\"");
+  CHECK (mkdir ("p/q"), "mkdir \"p/q\"");
+  CHECK ((p_fd = open ("p")) > 1, "open \"p\"");
+  CHECK ((fd = open ("p/q/..")) > 1, "open \"p/q/..\"");
+  CHECK (inumber (fd) == inumber (p_fd),
+         "compare inode numbers of \"p/q/..\" and \"p\"");
+  msg ("close \"p/q/..\"");
+  close (fd);
+  msg ("close \"p\"");
+  close (p_fd);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-dcache) begin
+(dir-dcache) mkdir "a"
+(dir-dcache) open "a/b" (must return -1)
+(dir-dcache) create "a/b"
+(dir-dcache) open "a/b"
+(dir-dcache) close "a/b"
+(dir-dcache) remove "a/b"
+(dir-dcache) open "a/b" (must return -1)
+(dir-dcache) open "a/.."
+(dir-dcache) close "a/.."
+(dir-dcache) rmdir "a"
+(dir-dcache) open "a/.." (must return -1)
+(dir-dcache) mkdir "p"
+(dir-dcache) mkdir "p/q"
+(dir-dcache) open "p"
+(dir-dcache) open "p/q/.."
+(dir-dcache) compare inode numbers of "p/q/.." and "p"
+(dir-dcache) close "p/q/.."
+(dir-dcache) close "p"
+(dir-dcache) end
+EOF
+pass;
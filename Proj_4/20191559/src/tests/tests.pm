@@ -33,6 +33,24 @@ sub check_expected {
     compare_output ("run", @options, \@output, $expected);
 }
 
+# Checks the output of a benchmark, whose timings vary from run to
+# run: it must contain $pass_line exactly and, for each of
+# @timing_regexes, some line that matches it.
+sub check_bench {
+    my ($pass_line, @timing_regexes) = @_;
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+
+    @output = get_core_output ("run", @output);
+    fail "missing \"$pass_line\" in output\n"
+      unless grep ($_ eq $pass_line, @output);
+    foreach my $regex (@timing_regexes) {
+	fail "no line of output matches $regex\n"
+	  unless grep (/$regex/, @output);
+    }
+    pass;
+}
+
 sub common_checks {
     my ($run, @output) = @_;
 
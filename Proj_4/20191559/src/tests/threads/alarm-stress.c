@@ -0,0 +1,111 @@
+/* Puts many threads to sleep at once and measures what the
+   sleepers cost the timer interrupt.
+
+   First counts how many times a busy loop runs per tick with no
+   sleepers, then again while SLEEPER_CNT threads sleep through
+   the measurement.  If the interrupt handler's cost does not
+   grow with the number of sleepers, the counts are about equal.
+   Then each sleeper sleeps ITER_CNT random intervals, checking
+   that it never wakes before its wake-up time.  The counts
+   depend on the machine, so only the wake-up checks can fail. */
+
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 128         /* Sleeping threads. */
+#define ITER_CNT 20             /* Random sleeps per thread. */
+#define MAX_SLEEP 16            /* Longest random sleep, in ticks. */
+#define SPIN_TICKS 10           /* Ticks to count busy loops over. */
+
+static int64_t wake_all;        /* When the first sleep ends. */
+static struct semaphore done;
+static int early_cnt;           /* # of threads that woke too soon. */
+
+static void sleeper (void *);
+static unsigned spins_per_tick (void);
+
+void
+test_alarm_stress (void) 
+{
+  unsigned idle_spins, busy_spins;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  random_init (0);
+  sema_init (&done, 0);
+
+  idle_spins = spins_per_tick ();
+
+  /* The sleepers have higher priority than us, so each one runs
+     and goes to sleep as soon as it is created. */
+  msg ("Creating %d sleeping threads.", SLEEPER_CNT);
+  wake_all = timer_ticks () + 4 * SPIN_TICKS;
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT + 1, sleeper, NULL) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+  busy_spins = spins_per_tick ();
+  if (timer_ticks () >= wake_all)
+    fail ("sleepers woke before the measurement finished");
+
+  msg ("Waiting for %d random sleeps per thread.", ITER_CNT);
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  if (early_cnt > 0)
+    fail ("%d threads woke up early", early_cnt);
+
+  msg ("All threads woke up on time.");
+  msg ("Busy loops per tick: %u with no sleepers, %u with %d sleepers.",
+       idle_spins, busy_spins, SLEEPER_CNT);
+}
+
+/* Sleeps until wake_all, then ITER_CNT random intervals,
+   checking each time that it did not wake up early. */
+static void
+sleeper (void *aux UNUSED) 
+{
+  int i;
+
+  timer_sleep (wake_all - timer_ticks ());
+  if (timer_ticks () < wake_all)
+    early_cnt++;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      int64_t duration = random_ulong () % MAX_SLEEP + 1;
+      int64_t wake = timer_ticks () + duration;
+
+      timer_sleep (duration);
+      if (timer_ticks () < wake)
+        early_cnt++;
+    }
+  sema_up (&done);
+}
+
+/* Returns the number of times a busy loop runs per timer tick,
+   averaged over SPIN_TICKS ticks. */
+static unsigned
+spins_per_tick (void) 
+{
+  int64_t start = timer_ticks ();
+  unsigned spins = 0;
+
+  /* Start counting at a tick boundary. */
+  while (timer_ticks () == start)
+    continue;
+  start++;
+  while (timer_ticks () < start + SPIN_TICKS)
+    spins++;
+  return spins / SPIN_TICKS;
+}
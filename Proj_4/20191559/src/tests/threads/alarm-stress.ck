@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ('(alarm-stress) All threads woke up on time.',
+	     qr/^\(alarm-stress\) Busy loops per tick: \d+ with no sleepers, \d+ with \d+ sleepers\.$/);
@@ -0,0 +1,149 @@
+/* Checks the word-at-a-time bitmap operations against a bit by
+   bit reference on random bitmaps, then times them on a large,
+   nearly full bitmap.  The timings depend on the machine, so
+   only the reference checks can fail. */
+
+#include <bitmap.h>
+#include <random.h>
+#include <round.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "devices/timer.h"
+
+#define CHECK_BITS 1000         /* Bits in each checked bitmap. */
+#define CHECK_ROUNDS 50         /* Random bitmaps checked. */
+#define BENCH_BITS (1 << 20)    /* Bits in the timed bitmap. */
+#define BENCH_SCANS 200         /* Scans timed. */
+
+static size_t ref_count (const struct bitmap *, size_t start, size_t cnt,
+                         bool value);
+static size_t ref_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool value);
+static void check (void);
+static void bench (void);
+
+void
+test_bitmap_bench (void) 
+{
+  check ();
+  bench ();
+}
+
+/* Compares bitmap_count() and bitmap_scan() to the references on
+   random bitmaps with runs of various lengths. */
+static void
+check (void)
+{
+  struct bitmap *b = bitmap_create (CHECK_BITS);
+  int round;
+
+  if (b == NULL)
+    fail ("couldn't allocate bitmap");
+  random_init (0);
+
+  msg ("Checking %d random bitmaps of %d bits.", CHECK_ROUNDS, CHECK_BITS);
+  for (round = 0; round < CHECK_ROUNDS; round++)
+    {
+      size_t i = 0;
+      int k;
+
+      /* Runs of up to 2 * ROUND + 1 bits of alternating value. */
+      while (i < CHECK_BITS)
+        {
+          size_t run = random_ulong () % (2 * round + 1) + 1;
+          if (run > CHECK_BITS - i)
+            run = CHECK_BITS - i;
+          bitmap_set_multiple (b, i, run, random_ulong () % 2);
+          i += run;
+        }
+
+      for (k = 0; k < 20; k++)
+        {
+          size_t start = random_ulong () % CHECK_BITS;
+          size_t cnt = random_ulong () % (CHECK_BITS - start + 1);
+          size_t run = random_ulong () % 70;
+          bool value = random_ulong () % 2;
+
+          if (bitmap_count (b, start, cnt, value)
+              != ref_count (b, start, cnt, value))
+            fail ("bitmap_count (%zu, %zu, %d) mismatch", start, cnt, value);
+          if (bitmap_scan (b, start, run, value)
+              != ref_scan (b, start, run, value))
+            fail ("bitmap_scan (%zu, %zu, %d) mismatch", start, run, value);
+        }
+    }
+  bitmap_destroy (b);
+  msg ("All checks passed.");
+}
+
+/* Times scans for a free run near the end of a bitmap that is
+   all set except for isolated free bits, the worst case for a
+   bit by bit scan. */
+static void
+bench (void)
+{
+  struct bitmap *b = bitmap_create (BENCH_BITS);
+  int64_t start;
+  size_t i;
+  int k;
+
+  if (b == NULL)
+    fail ("couldn't allocate bitmap");
+
+  bitmap_set_all (b, true);
+  for (i = 0; i < BENCH_BITS - 64; i += 97)
+    bitmap_reset (b, i);
+  bitmap_set_multiple (b, BENCH_BITS - 16, 16, false);
+
+  msg ("Timing %d scans of a %d-bit bitmap.", BENCH_SCANS, BENCH_BITS);
+  start = timer_ticks ();
+  for (k = 0; k < BENCH_SCANS; k++)
+    if (bitmap_scan (b, 0, 16, false) != BENCH_BITS - 16)
+      fail ("scan found the wrong run");
+  msg ("scan: %lld ticks.", timer_elapsed (start));
+
+  start = timer_ticks ();
+  for (k = 0; k < BENCH_SCANS; k++)
+    if (bitmap_count (b, 0, BENCH_BITS, false)
+        != DIV_ROUND_UP (BENCH_BITS - 64, 97) + 16)
+      fail ("count is wrong");
+  msg ("count: %lld ticks.", timer_elapsed (start));
+
+  start = timer_ticks ();
+  for (k = 0; k < BENCH_SCANS; k++)
+    bitmap_set_multiple (b, 0, BENCH_BITS, k % 2);
+  msg ("set_multiple: %lld ticks.", timer_elapsed (start));
+
+  bitmap_destroy (b);
+}
+
+/* Bit by bit bitmap_count(). */
+static size_t
+ref_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, n = 0;
+  for (i = start; i < start + cnt; i++)
+    if (bitmap_test (b, i) == value)
+      n++;
+  return n;
+}
+
+/* Bit by bit bitmap_scan(). */
+static size_t
+ref_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, j;
+
+  if (cnt > bitmap_size (b))
+    return BITMAP_ERROR;
+  for (i = start; i + cnt <= bitmap_size (b); i++)
+    {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test (b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  return BITMAP_ERROR;
+}
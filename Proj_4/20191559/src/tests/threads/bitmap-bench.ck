@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ('(bitmap-bench) All checks passed.',
+	     map (qr/^\(bitmap-bench\) $_: \d+ ticks\.$/,
+		  'scan', 'count', 'set_multiple'));
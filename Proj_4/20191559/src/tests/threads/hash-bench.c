@@ -0,0 +1,184 @@
+/* Compares struct hash and struct ptrmap as maps from page
+   addresses to page entries, like a supplemental page table.
+   Inserts ELEM_CNT page-aligned keys into each, looks every key
+   and as many absent keys up, and deletes every key, checking
+   each result.  Prints the ticks taken by each step.  The
+   timings depend on the machine, so only the checks can fail. */
+
+#include <hash.h>
+#include <ptrmap.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define ELEM_CNT 20000          /* Keys in each map. */
+#define ROUNDS 5                /* Times each step is repeated. */
+
+/* An entry keyed by a page address. */
+struct entry
+  {
+    void *vaddr;                /* Key. */
+    struct hash_elem elem;      /* Element in struct hash. */
+  };
+
+static struct entry *entries;
+
+/* Returns the address of the Ith page key, as in a user
+   process's address space. */
+static void *
+page_key (size_t i) 
+{
+  return (void *) (0x08048000 + i * PGSIZE);
+}
+
+static unsigned
+entry_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_int ((int) hash_entry (e, struct entry, elem)->vaddr);
+}
+
+static bool
+entry_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED) 
+{
+  return (hash_entry (a, struct entry, elem)->vaddr
+          < hash_entry (b, struct entry, elem)->vaddr);
+}
+
+static void bench_hash (void);
+static void bench_ptrmap (void);
+
+void
+test_hash_bench (void) 
+{
+  size_t i;
+
+  entries = malloc (sizeof *entries * ELEM_CNT);
+  if (entries == NULL)
+    fail ("couldn't allocate entries");
+  for (i = 0; i < ELEM_CNT; i++)
+    entries[i].vaddr = page_key (i);
+
+  msg ("Mapping %d page addresses, %d rounds.", ELEM_CNT, ROUNDS);
+  bench_hash ();
+  bench_ptrmap ();
+  msg ("All checks passed.");
+
+  free (entries);
+}
+
+/* Runs the steps on struct hash. */
+static void
+bench_hash (void) 
+{
+  int64_t insert = 0, find = 0, miss = 0, delete = 0, start;
+  struct hash h;
+  struct entry probe;
+  int round;
+  size_t i;
+
+  if (!hash_init (&h, entry_hash, entry_less, NULL))
+    fail ("hash_init failed");
+  for (round = 0; round < ROUNDS; round++)
+    {
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i++)
+        if (hash_insert (&h, &entries[i].elem) != NULL)
+          fail ("hash_insert found key %zu", i);
+      insert += timer_elapsed (start);
+      if (hash_size (&h) != ELEM_CNT)
+        fail ("hash_size is %zu", hash_size (&h));
+
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i++)
+        {
+          probe.vaddr = page_key (i);
+          if (hash_find (&h, &probe.elem) != &entries[i].elem)
+            fail ("hash_find missed key %zu", i);
+        }
+      find += timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i++)
+        {
+          probe.vaddr = page_key (ELEM_CNT + i);
+          if (hash_find (&h, &probe.elem) != NULL)
+            fail ("hash_find found absent key %zu", ELEM_CNT + i);
+        }
+      miss += timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i++)
+        {
+          probe.vaddr = page_key (i);
+          if (hash_delete (&h, &probe.elem) != &entries[i].elem)
+            fail ("hash_delete missed key %zu", i);
+        }
+      delete += timer_elapsed (start);
+      if (!hash_empty (&h))
+        fail ("hash not empty after deleting every key");
+    }
+  hash_destroy (&h, NULL);
+
+  msg ("hash: insert %lld, find %lld, miss %lld, delete %lld ticks.",
+       insert, find, miss, delete);
+}
+
+/* Runs the steps on struct ptrmap. */
+static void
+bench_ptrmap (void) 
+{
+  int64_t insert = 0, find = 0, miss = 0, delete = 0, start;
+  struct ptrmap m;
+  int round;
+  size_t i;
+
+  if (!ptrmap_init (&m))
+    fail ("ptrmap_init failed");
+  for (round = 0; round < ROUNDS; round++)
+    {
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i++)
+        if (!ptrmap_insert (&m, page_key (i), &entries[i]))
+          fail ("ptrmap_insert failed on key %zu", i);
+      insert += timer_elapsed (start);
+      if (ptrmap_size (&m) != ELEM_CNT)
+        fail ("ptrmap_size is %zu", ptrmap_size (&m));
+      if (ptrmap_insert (&m, page_key (0), &entries[0]))
+        fail ("ptrmap_insert accepted a duplicate key");
+
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i++)
+        if (ptrmap_find (&m, page_key (i)) != &entries[i])
+          fail ("ptrmap_find missed key %zu", i);
+      find += timer_elapsed (start);
+
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i++)
+        if (ptrmap_find (&m, page_key (ELEM_CNT + i)) != NULL)
+          fail ("ptrmap_find found absent key %zu", ELEM_CNT + i);
+      miss += timer_elapsed (start);
+
+      /* Delete every other key first, so that deletions close
+         gaps in the middle of probe sequences. */
+      start = timer_ticks ();
+      for (i = 0; i < ELEM_CNT; i += 2)
+        if (ptrmap_delete (&m, page_key (i)) != &entries[i])
+          fail ("ptrmap_delete missed key %zu", i);
+      for (i = 1; i < ELEM_CNT; i += 2)
+        if (ptrmap_find (&m, page_key (i)) != &entries[i])
+          fail ("ptrmap_find missed key %zu after deletions", i);
+      for (i = 1; i < ELEM_CNT; i += 2)
+        if (ptrmap_delete (&m, page_key (i)) != &entries[i])
+          fail ("ptrmap_delete missed key %zu", i);
+      delete += timer_elapsed (start);
+      if (ptrmap_size (&m) != 0)
+        fail ("ptrmap not empty after deleting every key");
+    }
+  ptrmap_destroy (&m, NULL, NULL);
+
+  msg ("ptrmap: insert %lld, find %lld, miss %lld, delete %lld ticks.",
+       insert, find, miss, delete);
+}
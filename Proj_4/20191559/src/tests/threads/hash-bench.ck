@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ('(hash-bench) All checks passed.',
+	     map (qr/^\(hash-bench\) $_: insert \d+, find \d+, miss \d+, delete \d+ ticks\.$/,
+		  'hash', 'ptrmap'));
@@ -0,0 +1,161 @@
+/* Unit test for the pairing heap in lib/kernel/heap.c.
+
+   Runs random insertions, removals of the top and of arbitrary
+   elements, and key changes against a reference, with many equal
+   keys, and after each one checks the heap order, the sibling and
+   parent links, and that the top is a least element. */
+
+#include <heap.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+
+#define ELEM_CNT 300            /* Elements. */
+#define KEY_CNT 50              /* Distinct keys. */
+#define OP_CNT 20000            /* Random operations. */
+
+struct value 
+  {
+    struct heap_elem elem;
+    int key;                    /* Sort key. */
+    bool in_heap;               /* True if in the heap. */
+  };
+
+static struct value values[ELEM_CNT];
+
+static bool
+value_less (const struct heap_elem *a, const struct heap_elem *b,
+            void *aux UNUSED) 
+{
+  return (heap_entry (a, struct value, elem)->key
+          < heap_entry (b, struct value, elem)->key);
+}
+
+static void check_heap (const struct heap *, size_t size);
+
+void
+test_heap_unit (void) 
+{
+  struct heap h;
+  size_t size = 0;
+  int op;
+
+  heap_init (&h, value_less, NULL);
+  random_init (0);
+  check_heap (&h, 0);
+
+  msg ("Running %d random operations on %d elements.", OP_CNT, ELEM_CNT);
+  for (op = 0; op < OP_CNT; op++) 
+    {
+      struct value *v = &values[random_ulong () % ELEM_CNT];
+      unsigned choice = random_ulong () % 8;
+
+      /* Grow the heap during the first half, shrink it during
+         the second, so that it passes through all sizes. */
+      if (!v->in_heap && choice < (op < OP_CNT / 2 ? 6u : 2u)) 
+        {
+          v->key = random_ulong () % KEY_CNT;
+          v->in_heap = true;
+          heap_push (&h, &v->elem);
+          size++;
+        }
+      else if (v->in_heap && choice < 2) 
+        {
+          /* Change the key in either direction. */
+          v->key = random_ulong () % KEY_CNT;
+          heap_update (&h, &v->elem);
+        }
+      else if (v->in_heap) 
+        {
+          heap_remove (&h, &v->elem);
+          v->in_heap = false;
+          size--;
+        }
+      else if (!heap_empty (&h)) 
+        {
+          v = heap_entry (heap_pop (&h), struct value, elem);
+          if (!v->in_heap)
+            fail ("heap_pop returned an element not in the heap");
+          v->in_heap = false;
+          size--;
+        }
+      check_heap (&h, size);
+    }
+
+  while (!heap_empty (&h)) 
+    {
+      struct value *v = heap_entry (heap_pop (&h), struct value, elem);
+      const struct value *top;
+
+      v->in_heap = false;
+      top = (heap_empty (&h) ? NULL
+             : heap_entry (heap_top (&h), struct value, elem));
+      if (top != NULL && top->key < v->key)
+        fail ("heap_pop out of order");
+    }
+  check_heap (&h, 0);
+  msg ("All checks passed.");
+}
+
+/* Checks that H is a valid heap with SIZE elements, that those
+   are exactly the elements marked in_heap, and that the top is a
+   least of them.  Walks the tree without recursion, since
+   pairing heaps can be deep. */
+static void
+check_heap (const struct heap *h, size_t size) 
+{
+  const struct heap_elem *e;
+  size_t cnt = 0;
+  int min_key = KEY_CNT;
+  int i;
+
+  if (heap_size (h) != size)
+    fail ("heap_size is %zu, expected %zu", heap_size (h), size);
+  if (heap_empty (h) != (size == 0))
+    fail ("heap_empty wrong");
+  if (h->root != NULL && (h->root->next != NULL || h->root->prev != NULL))
+    fail ("root has siblings");
+
+  /* Preorder walk: child first, then next sibling, climbing back
+     up through the parents when a sibling list ends. */
+  for (e = h->root; e != NULL; ) 
+    {
+      const struct heap_elem *c;
+
+      cnt++;
+      if (!heap_entry (e, struct value, elem)->in_heap)
+        fail ("removed element still in heap");
+      for (c = e->child; c != NULL; c = c->next) 
+        {
+          if (value_less (c, e, NULL))
+            fail ("child less than its parent");
+          if (c->prev == NULL
+              || (c == e->child ? c->prev != e : c->prev->next != c))
+            fail ("bad prev link");
+        }
+
+      if (e->child != NULL)
+        e = e->child;
+      else 
+        {
+          while (e != NULL && e->next == NULL) 
+            {
+              /* Climb to the parent: back along the siblings to
+                 the first child, whose prev is the parent. */
+              while (e->prev != NULL && e->prev->child != e)
+                e = e->prev;
+              e = e->prev;
+            }
+          if (e != NULL)
+            e = e->next;
+        }
+    }
+  if (cnt != size)
+    fail ("walk found %zu elements, expected %zu", cnt, size);
+
+  for (i = 0; i < ELEM_CNT; i++)
+    if (values[i].in_heap && values[i].key < min_key)
+      min_key = values[i].key;
+  if (size > 0 && heap_entry (heap_top (h), struct value, elem)->key != min_key)
+    fail ("heap_top is not a least element");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "test reported failure:\n" . join ("\n", grep (/FAIL/, @output)) . "\n"
+  if grep (/FAIL/, @output);
+fail "missing \"All checks passed.\" in output"
+  unless grep ($_ eq '(heap-unit) All checks passed.', @output);
+
+pass;
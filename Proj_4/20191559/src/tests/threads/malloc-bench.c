@@ -0,0 +1,74 @@
+/* Measures malloc() and free() throughput with many threads.
+
+   Each thread runs PAIRS_PER_THREAD malloc()/free() pairs over
+   the small size classes, keeping LIVE_CNT blocks alive at a
+   time, and all threads run at once.  Prints the number of pairs
+   per timer tick.  The figure depends on the machine, so the
+   test only checks that every thread finishes. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 16
+#define PAIRS_PER_THREAD 20000
+#define LIVE_CNT 8
+
+static struct semaphore done;
+
+static void bench_thread (void *);
+
+void
+test_malloc_bench (void) 
+{
+  long long total = (long long) THREAD_CNT * PAIRS_PER_THREAD;
+  int64_t start, elapsed;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to run %d malloc/free pairs each.",
+       THREAD_CNT, PAIRS_PER_THREAD);
+
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "bench %d", i);
+      thread_create (name, PRI_DEFAULT, bench_thread, NULL);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  elapsed = timer_elapsed (start);
+
+  msg ("All threads finished.");
+  msg ("%lld pairs in %lld ticks: %lld pairs per tick.",
+       total, elapsed, total / (elapsed > 0 ? elapsed : 1));
+}
+
+/* Runs PAIRS_PER_THREAD malloc()/free() pairs. */
+static void
+bench_thread (void *aux UNUSED) 
+{
+  void *live[LIVE_CNT] = { NULL };
+  int i;
+
+  for (i = 0; i < PAIRS_PER_THREAD; i++)
+    {
+      int slot = i % LIVE_CNT;
+
+      free (live[slot]);
+      live[slot] = malloc (16 << (i % 7));
+      if (live[slot] == NULL)
+        fail ("malloc failed on pair %d", i);
+    }
+  for (i = 0; i < LIVE_CNT; i++)
+    free (live[i]);
+  sema_up (&done);
+}
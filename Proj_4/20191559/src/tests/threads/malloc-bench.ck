@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ('(malloc-bench) All threads finished.',
+	     qr/^\(malloc-bench\) \d+ pairs in \d+ ticks: \d+ pairs per tick\.$/);
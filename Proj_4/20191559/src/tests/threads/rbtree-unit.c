@@ -0,0 +1,177 @@
+/* Unit test for the red-black tree in lib/kernel/rbtree.c.
+
+   Runs random insertions and removals against a reference, with
+   many equal keys, and after each one checks the red-black
+   properties, the parent links, the cached minimum, the order
+   and insertion order of equal elements, and the results of the
+   search functions. */
+
+#include <rbtree.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+
+#define ELEM_CNT 300            /* Elements. */
+#define KEY_CNT 50              /* Distinct keys. */
+#define OP_CNT 20000            /* Random operations. */
+
+struct value 
+  {
+    struct rb_elem elem;
+    int key;                    /* Sort key. */
+    int seq;                    /* Order of insertion. */
+    bool in_tree;               /* True if in the tree. */
+  };
+
+static struct value values[ELEM_CNT];
+
+static bool
+value_less (const struct rb_elem *a, const struct rb_elem *b,
+            void *aux UNUSED) 
+{
+  return (rb_entry (a, struct value, elem)->key
+          < rb_entry (b, struct value, elem)->key);
+}
+
+static int check_subtree (const struct rb_elem *,
+                          const struct rb_elem *parent);
+static void check_tree (const struct rb_tree *, size_t size);
+
+void
+test_rbtree_unit (void) 
+{
+  struct rb_tree t;
+  size_t size = 0;
+  int seq = 0;
+  int op;
+
+  rb_init (&t, value_less, NULL);
+  random_init (0);
+  check_tree (&t, 0);
+
+  msg ("Running %d random operations on %d elements.", OP_CNT, ELEM_CNT);
+  for (op = 0; op < OP_CNT; op++) 
+    {
+      struct value *v = &values[random_ulong () % ELEM_CNT];
+      struct value probe;
+      struct rb_elem *e;
+      int i;
+
+      /* Grow the tree during the first half, shrink it during
+         the second, so that it passes through all sizes. */
+      if (!v->in_tree && random_ulong () % 8 < (op < OP_CNT / 2 ? 6u : 2u)) 
+        {
+          v->key = random_ulong () % KEY_CNT;
+          v->seq = seq++;
+          v->in_tree = true;
+          rb_insert (&t, &v->elem);
+          size++;
+        }
+      else if (v->in_tree) 
+        {
+          rb_remove (&t, &v->elem);
+          v->in_tree = false;
+          size--;
+        }
+      else if (!rb_empty (&t) && random_ulong () % 2 == 0) 
+        {
+          v = rb_entry (rb_pop_min (&t), struct value, elem);
+          v->in_tree = false;
+          size--;
+        }
+      check_tree (&t, size);
+
+      /* Compare the searches with a search of every element. */
+      probe.key = random_ulong () % (KEY_CNT + 1);
+      e = NULL;
+      for (i = 0; i < ELEM_CNT; i++) 
+        {
+          struct value *w = &values[i];
+          if (w->in_tree && w->key >= probe.key
+              && (e == NULL
+                  || w->key < rb_entry (e, struct value, elem)->key
+                  || (w->key == rb_entry (e, struct value, elem)->key
+                      && w->seq < rb_entry (e, struct value, elem)->seq)))
+            e = &w->elem;
+        }
+      if (rb_lower_bound (&t, &probe.elem) != e)
+        fail ("rb_lower_bound (%d) wrong after %d operations",
+              probe.key, op);
+      if (e != NULL && rb_entry (e, struct value, elem)->key != probe.key)
+        e = NULL;
+      if (rb_find (&t, &probe.elem) != e)
+        fail ("rb_find (%d) wrong after %d operations", probe.key, op);
+    }
+
+  while (!rb_empty (&t))
+    rb_remove (&t, rb_max (&t));
+  check_tree (&t, 0);
+  msg ("All checks passed.");
+}
+
+/* Checks the subtree rooted at E, whose parent should be PARENT,
+   and returns its black height. */
+static int
+check_subtree (const struct rb_elem *e, const struct rb_elem *parent) 
+{
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+  if (e->parent != parent)
+    fail ("bad parent link");
+  if (e->red && ((e->left != NULL && e->left->red)
+                 || (e->right != NULL && e->right->red)))
+    fail ("red node with red child");
+
+  left = check_subtree (e->left, e);
+  right = check_subtree (e->right, e);
+  if (left != right)
+    fail ("black heights differ: %d vs. %d", left, right);
+  return left + !e->red;
+}
+
+/* Checks that T is a valid red-black tree with SIZE elements,
+   that the elements are exactly those marked in_tree, and that
+   they come out sorted by key and then by insertion order in
+   both directions. */
+static void
+check_tree (const struct rb_tree *t, size_t size) 
+{
+  const struct value *prev = NULL;
+  struct rb_elem *e;
+  size_t cnt = 0;
+
+  if (rb_size (t) != size)
+    fail ("rb_size is %zu, expected %zu", rb_size (t), size);
+  if (rb_empty (t) != (size == 0))
+    fail ("rb_empty wrong");
+  if (t->root != NULL && t->root->red)
+    fail ("red root");
+  check_subtree (t->root, NULL);
+  if (rb_min (t) != NULL && rb_prev (rb_min (t)) != NULL)
+    fail ("cached minimum is not the first element");
+
+  for (e = rb_min (t); e != NULL; e = rb_next (e)) 
+    {
+      const struct value *v = rb_entry (e, struct value, elem);
+
+      if (!v->in_tree)
+        fail ("removed element still in tree");
+      if (prev != NULL
+          && (prev->key > v->key
+              || (prev->key == v->key && prev->seq > v->seq)))
+        fail ("elements out of order");
+      prev = v;
+      cnt++;
+    }
+  if (cnt != size)
+    fail ("forward traversal found %zu elements, expected %zu", cnt, size);
+  if (rb_max (t) != (prev != NULL ? &prev->elem : NULL))
+    fail ("rb_max is not the last element");
+
+  for (e = rb_max (t); e != NULL; e = rb_prev (e))
+    cnt--;
+  if (cnt != 0)
+    fail ("backward traversal found the wrong number of elements");
+}
@@ -0,0 +1,63 @@
+/* The main thread holds a readers-writer lock for writing.  A
+   reader and then a writer, each of higher priority, block on
+   it and donate their priorities to the main thread.  When the
+   main thread releases the lock, the higher-priority writer gets
+   it first, then the reader, and the main thread's priority
+   drops back to the default. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_donate (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_write (&rw);
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+  thread_create ("writer", PRI_DEFAULT + 3, writer_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 3, thread_get_priority ());
+  rwlock_release_write (&rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("reader: acquiring read lock.");
+  rwlock_acquire_read (rw);
+  msg ("reader: got read lock.");
+  rwlock_release_read (rw);
+  msg ("reader: done.");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("writer: acquiring write lock.");
+  rwlock_acquire_write (rw);
+  msg ("writer: got write lock.");
+  rwlock_release_write (rw);
+  msg ("writer: done.");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-donate) begin
+(rwlock-donate) reader: acquiring read lock.
+(rwlock-donate) This thread should have priority 32.  Actual priority: 32.
+(rwlock-donate) writer: acquiring write lock.
+(rwlock-donate) This thread should have priority 34.  Actual priority: 34.
+(rwlock-donate) writer: got write lock.
+(rwlock-donate) writer: done.
+(rwlock-donate) reader: got read lock.
+(rwlock-donate) reader: done.
+(rwlock-donate) This thread should have priority 31.  Actual priority: 31.
+(rwlock-donate) end
+EOF
+pass;
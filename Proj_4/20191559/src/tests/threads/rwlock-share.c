@@ -0,0 +1,73 @@
+/* The main thread holds a readers-writer lock for reading.  A
+   higher-priority reader shares it right away.  Then a writer
+   blocks waiting for the readers to leave, and a later reader
+   blocks behind the writer rather than overtaking it.  When the
+   main thread leaves, the writer goes first, then the late
+   reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+static thread_func late_reader_thread_func;
+
+void
+test_rwlock_share (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  msg ("main: holding read lock.");
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &rw);
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread_func, &rw);
+  thread_create ("late-reader", PRI_DEFAULT + 3, late_reader_thread_func, &rw);
+  msg ("main: releasing read lock.");
+  rwlock_release_read (&rw);
+  msg ("main: done.");
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("reader: got read lock alongside main.");
+  rwlock_release_read (rw);
+  msg ("reader: done.");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("writer: waiting for readers.");
+  rwlock_acquire_write (rw);
+  msg ("writer: got write lock.");
+  rwlock_release_write (rw);
+  msg ("writer: done.");
+}
+
+static void
+late_reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  msg ("late reader: waiting behind writer.");
+  rwlock_acquire_read (rw);
+  msg ("late reader: got read lock.");
+  rwlock_release_read (rw);
+  msg ("late reader: done.");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-share) begin
+(rwlock-share) main: holding read lock.
+(rwlock-share) reader: got read lock alongside main.
+(rwlock-share) reader: done.
+(rwlock-share) writer: waiting for readers.
+(rwlock-share) late reader: waiting behind writer.
+(rwlock-share) main: releasing read lock.
+(rwlock-share) writer: got write lock.
+(rwlock-share) late reader: got read lock.
+(rwlock-share) late reader: done.
+(rwlock-share) writer: done.
+(rwlock-share) main: done.
+(rwlock-share) end
+EOF
+pass;
@@ -0,0 +1,112 @@
+/* Measures sema_up() on a semaphore with many waiters and checks
+   the order in which they wake up.
+
+   Creates WAITER_CNT threads of PRIORITY_CNT different priorities,
+   each of which blocks on one semaphore as soon as it starts.
+   Then, at a priority above all of them, ups the semaphore once
+   per waiter, timing each call with the CPU's time-stamp counter,
+   and finally lets the waiters run.  They must run in order of
+   decreasing priority, and in the order they started waiting
+   within each priority.  The cycle count depends on the machine,
+   so only the order can fail. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define WAITER_CNT 256          /* Waiting threads. */
+#define PRIORITY_CNT 16         /* Distinct waiter priorities. */
+
+struct waiter 
+  {
+    int id;                     /* Order of creation. */
+    int priority;               /* Priority. */
+  };
+
+static struct semaphore gate;   /* The contended semaphore. */
+static struct semaphore done;   /* Upped by each waiter on exit. */
+static struct waiter waiters[WAITER_CNT];
+static struct waiter *wake_order[WAITER_CNT];
+static int wake_cnt;
+
+static void waiter_func (void *);
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+read_tsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+void
+test_sema_bench (void) 
+{
+  uint64_t start, cycles;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&gate, 0);
+  sema_init (&done, 0);
+
+  /* The waiters have higher priority than us, so each one runs
+     and blocks on GATE as soon as it is created.  Spread the
+     priorities so that neighbors in creation order differ. */
+  msg ("Creating %d threads waiting on one semaphore.", WAITER_CNT);
+  for (i = 0; i < WAITER_CNT; i++)
+    {
+      struct waiter *w = &waiters[i];
+      char name[16];
+
+      w->id = i;
+      w->priority = PRI_DEFAULT + 1 + i * 7 % PRIORITY_CNT;
+      snprintf (name, sizeof name, "waiter %d", i);
+      if (thread_create (name, w->priority, waiter_func, w) == TID_ERROR)
+        fail ("couldn't create thread %d", i);
+    }
+
+  /* Wake them all without letting any of them run yet. */
+  thread_set_priority (PRI_MAX);
+  start = read_tsc ();
+  for (i = 0; i < WAITER_CNT; i++)
+    sema_up (&gate);
+  cycles = read_tsc () - start;
+  thread_set_priority (PRI_DEFAULT);
+
+  for (i = 0; i < WAITER_CNT; i++)
+    sema_down (&done);
+
+  if (wake_cnt != WAITER_CNT)
+    fail ("%d of %d waiters woke up", wake_cnt, WAITER_CNT);
+  for (i = 1; i < WAITER_CNT; i++)
+    {
+      struct waiter *a = wake_order[i - 1];
+      struct waiter *b = wake_order[i];
+
+      if (a->priority < b->priority
+          || (a->priority == b->priority && a->id > b->id))
+        fail ("waiter %d (priority %d) woke up before "
+              "waiter %d (priority %d)",
+              a->id, a->priority, b->id, b->priority);
+    }
+
+  msg ("All waiters woke up in priority order.");
+  msg ("Average sema_up() with up to %d waiters: %llu cycles.",
+       WAITER_CNT, (unsigned long long) (cycles / WAITER_CNT));
+}
+
+/* Waits on GATE, then records that it woke up. */
+static void
+waiter_func (void *w_) 
+{
+  struct waiter *w = w_;
+
+  sema_down (&gate);
+  wake_order[wake_cnt++] = w;
+  sema_up (&done);
+}
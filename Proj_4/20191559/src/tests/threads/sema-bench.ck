@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ('(sema-bench) All waiters woke up in priority order.',
+	     qr/^\(sema-bench\) Average sema_up\(\) with up to \d+ waiters: \d+ cycles\.$/);
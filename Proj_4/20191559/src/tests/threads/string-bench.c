@@ -0,0 +1,180 @@
+/* Checks memcpy(), memmove(), memset(), memcmp(), and strlen()
+   against byte by byte references at every alignment and at
+   sizes around the word-at-a-time thresholds, then times copies
+   of 16 bytes to 4 kB.  The timings depend on the machine, so
+   only the reference checks can fail. */
+
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define CHECK_MAX 80            /* Largest size checked. */
+#define BENCH_BYTES (8 << 20)   /* Bytes copied for each timed size. */
+
+static uint8_t *buf_a, *buf_b, *buf_c;
+
+static void check_copy (void);
+static void check_move (void);
+static void check_set (void);
+static void check_cmp_len (void);
+static void bench (void);
+
+void
+test_string_bench (void) 
+{
+  buf_a = palloc_get_page (PAL_ASSERT);
+  buf_b = palloc_get_page (PAL_ASSERT);
+  buf_c = palloc_get_page (PAL_ASSERT);
+  random_init (0);
+
+  msg ("Checking sizes 0 to %d at every alignment.", CHECK_MAX);
+  check_copy ();
+  check_move ();
+  check_set ();
+  check_cmp_len ();
+  msg ("All checks passed.");
+
+  bench ();
+
+  palloc_free_page (buf_a);
+  palloc_free_page (buf_b);
+  palloc_free_page (buf_c);
+}
+
+/* Checks that memcpy() copies exactly the requested bytes. */
+static void
+check_copy (void)
+{
+  size_t dst_ofs, src_ofs, size, i;
+
+  for (dst_ofs = 0; dst_ofs < 4; dst_ofs++)
+    for (src_ofs = 0; src_ofs < 4; src_ofs++)
+      for (size = 0; size <= CHECK_MAX; size++)
+        {
+          random_bytes (buf_a, CHECK_MAX + 8);
+          random_bytes (buf_b, CHECK_MAX + 8);
+          memcpy (buf_c, buf_b, CHECK_MAX + 8);
+          if (memcpy (buf_b + dst_ofs, buf_a + src_ofs, size)
+              != buf_b + dst_ofs)
+            fail ("memcpy returned the wrong pointer");
+          for (i = 0; i < CHECK_MAX + 8; i++)
+            {
+              uint8_t want = (i >= dst_ofs && i < dst_ofs + size
+                              ? buf_a[i - dst_ofs + src_ofs] : buf_c[i]);
+              if (buf_b[i] != want)
+                fail ("memcpy (+%zu, +%zu, %zu) wrong at byte %zu",
+                      dst_ofs, src_ofs, size, i);
+            }
+        }
+}
+
+/* Checks memmove() on overlapping blocks in both directions. */
+static void
+check_move (void)
+{
+  size_t dst_ofs, src_ofs, size, i;
+
+  for (dst_ofs = 0; dst_ofs < 12; dst_ofs++)
+    for (src_ofs = 0; src_ofs < 12; src_ofs++)
+      for (size = 0; size <= CHECK_MAX; size++)
+        {
+          random_bytes (buf_a, CHECK_MAX + 16);
+          memcpy (buf_c, buf_a, CHECK_MAX + 16);
+          if (memmove (buf_a + dst_ofs, buf_a + src_ofs, size)
+              != buf_a + dst_ofs)
+            fail ("memmove returned the wrong pointer");
+          for (i = 0; i < CHECK_MAX + 16; i++)
+            {
+              uint8_t want = (i >= dst_ofs && i < dst_ofs + size
+                              ? buf_c[i - dst_ofs + src_ofs] : buf_c[i]);
+              if (buf_a[i] != want)
+                fail ("memmove (+%zu, +%zu, %zu) wrong at byte %zu",
+                      dst_ofs, src_ofs, size, i);
+            }
+        }
+}
+
+/* Checks that memset() fills exactly the requested bytes. */
+static void
+check_set (void)
+{
+  size_t ofs, size, i;
+
+  for (ofs = 0; ofs < 4; ofs++)
+    for (size = 0; size <= CHECK_MAX; size++)
+      {
+        int value = random_ulong () % 256;
+
+        random_bytes (buf_a, CHECK_MAX + 8);
+        memcpy (buf_c, buf_a, CHECK_MAX + 8);
+        memset (buf_a + ofs, value | 0x100, size);
+        for (i = 0; i < CHECK_MAX + 8; i++)
+          {
+            uint8_t want = i >= ofs && i < ofs + size ? value : buf_c[i];
+            if (buf_a[i] != want)
+              fail ("memset (+%zu, %d, %zu) wrong at byte %zu",
+                    ofs, value, size, i);
+          }
+      }
+}
+
+/* Checks memcmp() with one differing byte at each position, and
+   strlen() with the terminator at each position. */
+static void
+check_cmp_len (void)
+{
+  size_t ofs, size, diff;
+
+  for (ofs = 0; ofs < 4; ofs++)
+    for (size = 0; size <= CHECK_MAX; size++)
+      {
+        random_bytes (buf_a, CHECK_MAX + 8);
+        memcpy (buf_b + ofs, buf_a, CHECK_MAX + 4);
+        if (memcmp (buf_a, buf_b + ofs, size) != 0)
+          fail ("memcmp of %zu equal bytes is nonzero", size);
+        for (diff = 0; diff < size; diff++)
+          {
+            uint8_t old = buf_b[ofs + diff];
+
+            buf_b[ofs + diff] = buf_a[diff] ^ 0x80;
+            if ((memcmp (buf_a, buf_b + ofs, size) < 0)
+                != (buf_a[diff] < buf_b[ofs + diff]))
+              fail ("memcmp (+%zu, %zu) wrong with byte %zu differing",
+                    ofs, size, diff);
+            buf_b[ofs + diff] = old;
+          }
+
+        memset (buf_a + ofs, 'x', size);
+        buf_a[ofs + size] = '\0';
+        if (strlen ((char *) buf_a + ofs) != size)
+          fail ("strlen (+%zu) of %zu-byte string wrong", ofs, size);
+      }
+}
+
+/* Times BENCH_BYTES of copying in blocks of 16 bytes to 4 kB
+   from one page to another, then as much clearing of pages. */
+static void
+bench (void)
+{
+  int64_t start;
+  size_t size, i;
+
+  msg ("Timing %d bytes of copies at each size.", BENCH_BYTES);
+  for (size = 16; size <= PGSIZE; size *= 4)
+    {
+      start = timer_ticks ();
+      for (i = 0; i < BENCH_BYTES / size; i++)
+        memcpy (buf_b, buf_a, size);
+      msg ("memcpy %zu: %lld ticks.", size, timer_elapsed (start));
+    }
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_BYTES / PGSIZE; i++)
+    memset (buf_b, i, PGSIZE);
+  msg ("memset %d: %lld ticks.", PGSIZE, timer_elapsed (start));
+}
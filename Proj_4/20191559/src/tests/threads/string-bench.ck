@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ('(string-bench) All checks passed.',
+	     map (qr/^\(string-bench\) $_: \d+ ticks\.$/,
+		  'memcpy 16', 'memcpy 64', 'memcpy 256', 'memcpy 1024',
+		  'memcpy 4096', 'memset 4096'));
@@ -32,6 +32,16 @@ static const struct test tests[] =
     {"priority-sema", test_priority_sema},
     {"priority-aging", test_priority_aging},
     {"priority-condvar", test_priority_condvar},
+    {"malloc-bench", test_malloc_bench},
+    {"bitmap-bench", test_bitmap_bench},
+    {"string-bench", test_string_bench},
+    {"hash-bench", test_hash_bench},
+    {"rbtree-unit", test_rbtree_unit},
+    {"heap-unit", test_heap_unit},
+    {"alarm-stress", test_alarm_stress},
+    {"sema-bench", test_sema_bench},
+    {"rwlock-share", test_rwlock_share},
+    {"rwlock-donate", test_rwlock_donate},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
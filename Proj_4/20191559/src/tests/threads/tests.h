@@ -26,6 +26,16 @@ extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_aging;
 extern test_func test_priority_condvar;
+extern test_func test_malloc_bench;
+extern test_func test_bitmap_bench;
+extern test_func test_string_bench;
+extern test_func test_hash_bench;
+extern test_func test_rbtree_unit;
+extern test_func test_heap_unit;
+extern test_func test_alarm_stress;
+extern test_func test_sema_bench;
+extern test_func test_rwlock_share;
+extern test_func test_rwlock_donate;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
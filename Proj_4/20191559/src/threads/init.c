@@ -21,6 +21,7 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -39,6 +40,9 @@
 #endif
 
 #include "vm/swap.h"
+#ifdef VM
+#include "vm/ksm.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -99,6 +103,7 @@ main (void)
   /* Initialize memory system. */
   palloc_init (user_page_limit);
   malloc_init ();
+  slab_init ();
   paging_init ();
 
   /* Segmentation. */
@@ -131,8 +136,11 @@ main (void)
 
   printf ("Boot complete.\n");
 
+#ifdef VM
   init_LRU();
-  initialize_swap();
+  initialize_swap (swap_bdev_name);
+  ksm_init();
+#endif
   
   /* Run actions specified on kernel command line. */
   run_actions (argv);
@@ -255,16 +263,24 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-ksm"))
+        {
+          ksm_enabled = true;
+          if (value != NULL && atoi (value) > 0)
+            ksm_pages_to_scan = atoi (value);
+        }
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
 
 #ifndef USERPROG
       else if (!strcmp (name, "-aging"))
-        thread_prior_aging = true;
+        thread_aging = true;
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
 #endif
@@ -319,6 +335,7 @@ run_actions (char **argv)
       {"run", 2, run_task},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
+      {"frag", 1, fsutil_frag},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
@@ -367,6 +384,7 @@ usage (void)
 #endif
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
+          "  frag               Count the extents of each file in the root.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
@@ -382,11 +400,14 @@ usage (void)
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
-          "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -swap=BDEV[:PRIO][,...]  Swap to the listed BDEVs, striping\n"
+          "                     across the highest PRIO (default 0) first.\n"
+          "  -ksm[=PAGES]       Merge identical pages, scanning PAGES per pass.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the timer tick while idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -401,9 +422,6 @@ locate_block_devices (void)
 {
   locate_block_device (BLOCK_FILESYS, filesys_bdev_name);
   locate_block_device (BLOCK_SCRATCH, scratch_bdev_name);
-#ifdef VM
-  locate_block_device (BLOCK_SWAP, swap_bdev_name);
-#endif
 }
 
 /* Figures out what block device to use for the given ROLE: the
@@ -5,8 +5,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* A simple implementation of malloc().
@@ -28,19 +31,63 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Blocks bigger than 1 kB don't pack well into a single page
+   with an arena header, so the sizes between 1 kB and 12 kB get
+   descriptors of their own (1.5, 2, 3, 4, 6, 8 and 12 kB) whose
+   arenas span several pages, chosen so the blocks tile them
+   exactly: three pages hold four 3 kB blocks, for instance.  The
+   header of such an arena is malloc()'d separately, and the page
+   allocator records it as the owner of each of the arena's pages
+   (palloc_set_owner()), which is how a block finds its arena.
+
+   We handle blocks bigger than the largest descriptor by
+   allocating contiguous pages with the page allocator and
+   sticking the allocation size at the beginning of the allocated
+   block's arena header.  realloc() grows such a block in place
+   when the pages after it are free.
+
+   Taking a descriptor's lock on every call is costly, so each
+   thread also keeps a "magazine" per small descriptor (up to
+   MAG_MAX_BLOCK bytes, so big blocks don't linger in caches): a
+   small stack of
+   blocks it freed recently.  malloc() pops from the magazine and
+   free() pushes onto it without locking anything, since no other
+   thread touches it.  Only when the magazine runs empty (or full)
+   do we take the lock, and then we move MAG_BATCH blocks between
+   the magazine and the descriptor's free list at once.  Blocks
+   in a magazine still count as in use in their arena, so an
+   arena is never freed under a magazine.  A thread's magazines
+   are emptied back into the free lists when it exits.
+
+   Interrupt handlers have one shared set of magazines.  There
+   we may not wait for a lock, so the lock is only tried: if it
+   is busy, malloc() fails, and free() parks the block on the
+   descriptor's deferred list, which the next locked call drains. */
+
+/* Blocks a magazine holds, and how many move at once between
+   a magazine and its descriptor. */
+#define MAG_SIZE 16
+#define MAG_BATCH (MAG_SIZE / 2)
+
+/* Largest block size cached in magazines. */
+#define MAG_MAX_BLOCK 1024
 
 /* Descriptor. */
 struct desc
   {
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
+    size_t arena_pages;         /* Pages per arena, 0 if the arena
+                                   header is inside its only page. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    struct list deferred;       /* Blocks freed while LOCK was busy in
+                                   an interrupt handler.  Guarded by
+                                   disabling interrupts. */
+
+    /* Statistics. */
+    long long alloc_cnt;        /* # of blocks handed out. */
+    long long req_bytes;        /* Bytes requested for them. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -52,6 +99,7 @@ struct arena
     unsigned magic;             /* Always set to ARENA_MAGIC. */
     struct desc *desc;          /* Owning descriptor, null for big block. */
     size_t free_cnt;            /* Free blocks; pages in big block. */
+    uint8_t *pages;             /* First block, if header is separate. */
   };
 
 /* Free block. */
@@ -60,18 +108,58 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Magazine: free blocks of one descriptor, private to a thread
+   (or to interrupt context). */
+struct magazine
+  {
+    size_t cnt;                         /* Number of blocks held. */
+    struct block *blocks[MAG_SIZE];     /* Blocks, most recent last. */
+  };
+
+/* Descriptors past the powers of 2, as {block size, arena pages}. */
+static const size_t multi_page_classes[][2] =
+  {
+    {1536, 3}, {2048, 1}, {3072, 3}, {4096, 1},
+    {6144, 3}, {8192, 2}, {12288, 3},
+  };
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[16];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
+static size_t mag_desc_cnt;     /* Descriptors with magazines, first. */
+
+/* Magazines for interrupt context. */
+static struct magazine intr_magazines[16];
+
+/* Marks a thread that must not use magazines: while they are
+   being allocated, and once it is exiting. */
+#define NO_MAGAZINES ((struct magazine *) 1)
+
+/* Statistics. */
+static long long mag_allocs;    /* # of malloc()s served by a magazine. */
+static long long mag_frees;     /* # of free()s absorbed by a magazine. */
+static long long locked_calls;  /* # of calls that took a descriptor lock. */
+static long long big_allocs;    /* # of big blocks allocated. */
+static long long big_req_bytes; /* Bytes requested for them. */
+static long long big_pages;     /* Pages given to them. */
+static long long realloc_in_place; /* # of realloc()s that kept the block. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct magazine *get_magazine (struct desc *);
+static struct block *take_block (struct desc *);
+static void put_block (struct desc *, struct block *);
+static struct arena *new_arena (struct desc *);
+static void drain_deferred (struct desc *);
+static bool lock_desc (struct desc *);
+static size_t block_size (void *);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) 
 {
   size_t block_size;
+  size_t i;
 
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
     {
@@ -79,8 +167,24 @@ malloc_init (void)
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->arena_pages = 0;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      list_init (&d->deferred);
+      if (block_size <= MAG_MAX_BLOCK)
+        mag_desc_cnt = desc_cnt;
+    }
+
+  for (i = 0; i < sizeof multi_page_classes / sizeof *multi_page_classes; i++)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = multi_page_classes[i][0];
+      d->arena_pages = multi_page_classes[i][1];
+      d->blocks_per_arena = d->arena_pages * PGSIZE / d->block_size;
+      list_init (&d->free_list);
+      lock_init (&d->lock);
+      list_init (&d->deferred);
     }
 }
 
@@ -92,6 +196,7 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct magazine *mag;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -108,6 +213,8 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL && slab_reclaim () > 0)
+        a = palloc_get_multiple (0, page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -116,39 +223,37 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+      a->pages = NULL;
+      big_allocs++;
+      big_req_bytes += size;
+      big_pages += page_cnt;
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
+  d->alloc_cnt++;
+  d->req_bytes += size;
 
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Fast path: the most recently freed block in our magazine. */
+  mag = get_magazine (d);
+  if (mag != NULL && mag->cnt > 0)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+      mag_allocs++;
+      return mag->blocks[--mag->cnt];
     }
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  if (!lock_desc (d))
+    return NULL;
+
+  /* Refill the magazine with a batch, keeping one block for us. */
+  b = take_block (d);
+  if (b != NULL && mag != NULL)
+    while (mag->cnt < MAG_BATCH)
+      {
+        struct block *extra = take_block (d);
+        if (extra == NULL)
+          break;
+        mag->blocks[mag->cnt++] = extra;
+      }
   lock_release (&d->lock);
   return b;
 }
@@ -185,6 +290,37 @@ block_size (void *block)
   return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
+/* Tries to resize BLOCK to NEW_SIZE bytes without moving it.
+   Returns true if successful. */
+static bool
+resize_in_place (void *block, size_t new_size)
+{
+  struct arena *a = block_to_arena (block);
+  size_t old_size = block_size (block);
+  size_t page_cnt;
+
+  if (a->desc != NULL)
+    {
+      /* Keep a class block unless that wastes over half of it. */
+      return new_size <= old_size && new_size > old_size / 2;
+    }
+
+  /* A big block: give back or take on whole pages at its end,
+     as long as it stays too big for any descriptor. */
+  if (new_size <= descs[desc_cnt - 1].block_size)
+    return false;
+  page_cnt = DIV_ROUND_UP (new_size + sizeof *a, PGSIZE);
+  if (page_cnt < a->free_cnt)
+    palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE,
+                          a->free_cnt - page_cnt);
+  else if (page_cnt > a->free_cnt
+           && !palloc_extend (a, a->free_cnt, page_cnt))
+    return false;
+  big_pages += (long long) page_cnt - (long long) a->free_cnt;
+  a->free_cnt = page_cnt;
+  return true;
+}
+
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
    moving it in the process.
    If successful, returns the new block; on failure, returns a
@@ -199,6 +335,11 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL && resize_in_place (old_block, new_size))
+    {
+      realloc_in_place++;
+      return old_block;
+    }
   else 
     {
       void *new_block = malloc (new_size);
@@ -223,6 +364,7 @@ free (void *p)
       struct block *b = p;
       struct arena *a = block_to_arena (b);
       struct desc *d = a->desc;
+      struct magazine *mag;
       
       if (d != NULL) 
         {
@@ -233,24 +375,36 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
+          /* Fast path: keep the block in our magazine. */
+          mag = get_magazine (d);
+          if (mag != NULL && mag->cnt < MAG_SIZE)
+            {
+              mag_frees++;
+              mag->blocks[mag->cnt++] = b;
+              return;
+            }
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
+          if (!lock_desc (d))
+            {
+              /* Busy lock in an interrupt handler: defer. */
+              list_push_front (&d->deferred, &b->free_elem);
+              return;
+            }
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          if (mag != NULL)
             {
+              /* Return the oldest batch, keeping the hot blocks. */
               size_t i;
 
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              for (i = 0; i < MAG_BATCH; i++)
+                put_block (d, mag->blocks[i]);
+              mag->cnt -= MAG_BATCH;
+              memmove (mag->blocks, mag->blocks + MAG_BATCH,
+                       mag->cnt * sizeof *mag->blocks);
+              mag->blocks[mag->cnt++] = b;
             }
+          else
+            put_block (d, b);
 
           lock_release (&d->lock);
         }
@@ -263,11 +417,245 @@ free (void *p)
     }
 }
 
+/* Empties the current thread's magazines back into the
+   descriptors' free lists and frees them.  Called on thread
+   exit. */
+void
+malloc_thread_exit (void)
+{
+  struct thread *t = thread_current ();
+  struct magazine *mags = t->magazines;
+  size_t i;
+
+  ASSERT (!intr_context ());
+  t->magazines = NO_MAGAZINES;
+  if (mags == NULL || mags == NO_MAGAZINES)
+    return;
+
+  for (i = 0; i < mag_desc_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+      struct magazine *mag = &mags[i];
+
+      if (mag->cnt == 0)
+        continue;
+      lock_desc (d);
+      while (mag->cnt > 0)
+        put_block (d, mag->blocks[--mag->cnt]);
+      lock_release (&d->lock);
+    }
+  free (mags);
+}
+
+/* Prints magazine statistics, and for each size class the
+   number of allocations and the share of their bytes that went
+   unused to rounding. */
+void
+malloc_print_stats (void)
+{
+  size_t i;
+
+  printf ("Malloc: %lld allocs and %lld frees from magazines, "
+          "%lld locked calls, %lld reallocs in place\n",
+          mag_allocs, mag_frees, locked_calls, realloc_in_place);
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+      long long given = d->alloc_cnt * (long long) d->block_size;
+
+      if (d->alloc_cnt == 0)
+        continue;
+      printf ("Malloc: %5zu-byte blocks: %lld allocs, %lld%% waste\n",
+              d->block_size, d->alloc_cnt,
+              (given - d->req_bytes) * 100 / given);
+    }
+  if (big_allocs > 0)
+    printf ("Malloc: big blocks: %lld allocs, %lld%% waste\n", big_allocs,
+            (big_pages * PGSIZE - big_req_bytes) * 100 / (big_pages * PGSIZE));
+}
+
+/* Returns the calling context's magazine for descriptor D, or a
+   null pointer if it has none.  A thread's magazines are
+   allocated on first use. */
+static struct magazine *
+get_magazine (struct desc *d)
+{
+  struct thread *t;
+  struct magazine *mags;
+
+  if ((size_t) (d - descs) >= mag_desc_cnt)
+    return NULL;
+  if (intr_context ())
+    return &intr_magazines[d - descs];
+
+  t = thread_current ();
+  if (t->magazines == NULL)
+    {
+      /* Allocating the magazines calls malloc(), which must take
+         the locked path for this thread meanwhile. */
+      t->magazines = NO_MAGAZINES;
+      mags = malloc (mag_desc_cnt * sizeof *mags);
+      if (mags != NULL)
+        memset (mags, 0, mag_desc_cnt * sizeof *mags);
+      t->magazines = mags;
+    }
+  if (t->magazines == NULL || t->magazines == NO_MAGAZINES)
+    return NULL;
+  return &t->magazines[d - descs];
+}
+
+/* Acquires D's lock and drains its deferred list.  In an
+   interrupt handler, only tries, returning false if the lock is
+   busy.  Returns true if the lock was acquired. */
+static bool
+lock_desc (struct desc *d)
+{
+  if (intr_context ())
+    {
+      if (!lock_try_acquire (&d->lock))
+        return false;
+    }
+  else
+    lock_acquire (&d->lock);
+  locked_calls++;
+  drain_deferred (d);
+  return true;
+}
+
+/* Obtains the memory for a new arena of descriptor D: a page
+   with room for the header, or for a multi-page arena, the pages
+   plus a separately allocated header.  Returns the header, with
+   only its PAGES member set, or a null pointer if memory is not
+   available. */
+static struct arena *
+new_arena (struct desc *d)
+{
+  size_t page_cnt = d->arena_pages != 0 ? d->arena_pages : 1;
+  struct arena *a;
+  void *pages;
+
+  pages = palloc_get_multiple (0, page_cnt);
+  if (pages == NULL && !intr_context () && slab_reclaim () > 0)
+    pages = palloc_get_multiple (0, page_cnt);
+  if (pages == NULL)
+    return NULL;
+  if (d->arena_pages == 0)
+    {
+      a = pages;
+      a->pages = NULL;
+      return a;
+    }
+
+  /* The header comes from a smaller descriptor, never D. */
+  a = malloc (sizeof *a);
+  if (a == NULL)
+    {
+      palloc_free_multiple (pages, page_cnt);
+      return NULL;
+    }
+  a->pages = pages;
+  palloc_set_owner (pages, page_cnt, a);
+  return a;
+}
+
+/* Takes a free block from D, creating a new arena if D's free
+   list is empty.  D's lock must be held.  Returns a null pointer
+   if memory is not available. */
+static struct block *
+take_block (struct desc *d)
+{
+  struct block *b;
+  struct arena *a;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      a = new_arena (d);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++)
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Returns block B to D's free list, freeing its arena if that
+   leaves the arena unused.  D's lock must be held. */
+static void
+put_block (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena)
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++)
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      if (d->arena_pages != 0)
+        {
+          a->magic = 0;
+          palloc_free_multiple (a->pages, d->arena_pages);
+          free (a);
+        }
+      else
+        palloc_free_page (a);
+    }
+}
+
+/* Moves the blocks on D's deferred list back to its free list.
+   D's lock must be held. */
+static void
+drain_deferred (struct desc *d)
+{
+  enum intr_level old_level = intr_disable ();
+  while (!list_empty (&d->deferred))
+    put_block (d, list_entry (list_pop_front (&d->deferred),
+                              struct block, free_elem));
+  intr_set_level (old_level);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
 {
-  struct arena *a = pg_round_down (b);
+  struct arena *a = palloc_get_owner (b);
+
+  if (a != NULL)
+    {
+      /* Multi-page arena. */
+      ASSERT (a->magic == ARENA_MAGIC);
+      ASSERT (((uint8_t *) b - a->pages) % a->desc->block_size == 0);
+      return a;
+    }
+  a = pg_round_down (b);
 
   /* Check that the arena is valid. */
   ASSERT (a != NULL);
@@ -288,6 +676,8 @@ arena_to_block (struct arena *a, size_t idx)
   ASSERT (a != NULL);
   ASSERT (a->magic == ARENA_MAGIC);
   ASSERT (idx < a->desc->blocks_per_arena);
+  if (a->pages != NULL)
+    return (struct block *) (a->pages + idx * a->desc->block_size);
   return (struct block *) ((uint8_t *) a
                            + sizeof *a
                            + idx * a->desc->block_size);
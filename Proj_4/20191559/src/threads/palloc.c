@@ -2,13 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,22 +24,96 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy system.  Free memory is kept as
+   blocks of 2**K pages, for K up to MAX_ORDER, aligned to their
+   size relative to the pool base, one free list per order.  A
+   request for N pages takes the smallest free block that fits,
+   splitting larger blocks in half as needed, and gives the pages
+   past N back right away.  Freeing merges a block with its
+   "buddy", the other half of the block it was split from, for
+   as long as that buddy is free too.  Both take O(log n) list
+   operations.  Since any page range can be freed, a range is
+   freed as the aligned power-of-2 blocks it is made of.
+
+   Each pool also keeps a small stack of pages that the idle
+   thread has already zeroed (see palloc_prezero_page()).  Those
+   pages are allocated as far as the buddy system knows, so
+   nothing else hands them out; a single-page PAL_ZERO request
+   pops one instead of clearing a page itself.  If the pool runs
+   dry, the stack is given back before the request fails.
+
+   Pages are freed from the scheduler (thread_schedule_tail()),
+   where blocking on a lock is not an option, so the pools are
+   protected by disabling interrupts instead.  Every critical
+   section is O(log n) or better. */
+
+/* Largest block order: 2**MAX_ORDER pages, 32 MB. */
+#define MAX_ORDER 13
+
+/* Marks a page that does not start a free block in a pool's
+   order map. */
+#define NOT_FREE 0xff
+
+/* Pre-zeroed pages kept per pool. */
+#define ZERO_POOL_TARGET 32
+
+/* A free buddy block, stored in its own first page. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in a free list. */
+  };
+
+/* A pre-zeroed page on a pool's zero stack.  Only the first word
+   is non-zero; it is cleared when the page is popped. */
+struct zero_page
+  {
+    struct zero_page *next;             /* Next pre-zeroed page. */
+  };
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+
+    /* Buddy system. */
+    struct list free_lists[MAX_ORDER + 1]; /* Free blocks, by order. */
+    size_t free_cnt[MAX_ORDER + 1];     /* Blocks on each free list. */
+    uint8_t *order_map;                 /* Per page: order of the free
+                                           block it starts, or NOT_FREE. */
+    void **owner_map;                   /* Per page: see palloc_set_owner(). */
+
+    /* Pre-zeroed pages. */
+    struct zero_page *zero_pages;       /* Stack of pre-zeroed pages. */
+    size_t zero_cnt;                    /* Number of pages on it. */
   };
 
+/* PAL_ZERO statistics. */
+static long long zero_hits;     /* # of pages taken pre-zeroed. */
+static long long zero_misses;   /* # of pages zeroed on request. */
+static long long zero_filled;   /* # of pages zeroed by the idle thread. */
+
+/* Allocation statistics. */
+static long long split_cnt;     /* # of blocks split in two. */
+static long long merge_cnt;     /* # of buddies merged on free. */
+static long long fail_cnt;      /* # of requests that found no block. */
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *pool_of (void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static bool buddy_claim (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void *pop_zero_page (struct pool *);
+static bool drain_zero_pages (struct pool *);
+static void print_pool_stats (const struct pool *, const char *name);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -71,15 +146,30 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  if ((flags & PAL_ZERO) && page_cnt == 1)
+    {
+      pages = pop_zero_page (pool);
+      if (pages != NULL)
+        {
+          zero_hits++;
+          return pages;
+        }
+    }
+
+  old_level = intr_disable ();
+  page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && drain_zero_pages (pool))
+    page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR)
+    fail_cnt++;
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -89,7 +179,10 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (pages != NULL) 
     {
       if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
+        {
+          zero_misses += page_cnt;
+          memset (pages, 0, PGSIZE * page_cnt);
+        }
     }
   else 
     {
@@ -118,27 +211,24 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  pool = pool_of (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
+  memset (pool->owner_map + page_idx, 0, page_cnt * sizeof *pool->owner_map);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +238,373 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Tries to grow the allocation of PAGE_CNT pages at PAGES to
+   NEW_CNT pages in place, by taking the pages that follow it.
+   Returns true if successful, false if any of them is in use. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt)
+{
+  struct pool *pool = pool_of (pages);
+  enum intr_level old_level;
+  size_t page_idx;
+  bool success;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_cnt >= page_cnt);
+
+  page_idx = pg_no (pages) - pg_no (pool->base);
+  old_level = intr_disable ();
+  success = buddy_claim (pool, page_idx + page_cnt, new_cnt - page_cnt);
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Records OWNER for each of the PAGE_CNT allocated pages starting
+   at PAGES, so palloc_get_owner() can find it from any address in
+   them.  Freeing the pages clears the record. */
+void
+palloc_set_owner (void *pages, size_t page_cnt, void *owner)
+{
+  struct pool *pool = pool_of (pages);
+  size_t page_idx = pg_no (pages) - pg_no (pool->base);
+  size_t i;
+
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  for (i = 0; i < page_cnt; i++)
+    pool->owner_map[page_idx + i] = owner;
+}
+
+/* Returns the owner recorded for the page containing ADDR, or a
+   null pointer if none. */
+void *
+palloc_get_owner (const void *addr)
+{
+  struct pool *pool = pool_of ((void *) addr);
+  return pool->owner_map[pg_no (addr) - pg_no (pool->base)];
+}
+
+/* Zeroes one free page into a pool's zero stack, if a pool is
+   short of pre-zeroed pages.  Called by the idle thread, which
+   must never block.  Returns true if a page was zeroed. */
+bool
+palloc_prezero_page (void)
+{
+  struct pool *pools[] = { &kernel_pool, &user_pool };
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      struct zero_page *zp;
+      enum intr_level old_level;
+      size_t page_idx;
+
+      if (pool->used_map == NULL || pool->zero_cnt >= ZERO_POOL_TARGET)
+        continue;
+
+      old_level = intr_disable ();
+      page_idx = buddy_alloc (pool, 1);
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        continue;
+
+      /* The page is ours now, so clear it with interrupts on. */
+      zp = (struct zero_page *) (pool->base + PGSIZE * page_idx);
+      memset (zp, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      zp->next = pool->zero_pages;
+      pool->zero_pages = zp;
+      pool->zero_cnt++;
+      zero_filled++;
+      intr_set_level (old_level);
+      return true;
+    }
+  return false;
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  long long requests = zero_hits + zero_misses;
+
+  printf ("Palloc: %lld zero pages prefilled, %lld of %lld PAL_ZERO "
+          "pages pre-zeroed (%lld%%)\n", zero_filled, zero_hits, requests,
+          requests ? zero_hits * 100 / requests : 0);
+  printf ("Palloc: %lld splits, %lld merges, %lld failed requests\n",
+          split_cnt, merge_cnt, fail_cnt);
+  print_pool_stats (&kernel_pool, "kernel pool");
+  print_pool_stats (&user_pool, "user pool");
+}
+
+/* Prints POOL's free blocks per order and how fragmented its free
+   memory is: the share of free pages that lie outside the largest
+   free block, 0% when all free memory is one block. */
+static void
+print_pool_stats (const struct pool *pool, const char *name)
+{
+  size_t free_pages = 0;
+  size_t largest = 0;
+  int order;
+
+  if (pool->used_map == NULL)
+    return;
+
+  printf ("Palloc: %s free blocks:", name);
+  for (order = 0; order <= MAX_ORDER; order++)
+    {
+      printf (" %zu", pool->free_cnt[order]);
+      free_pages += pool->free_cnt[order] << order;
+      if (pool->free_cnt[order] > 0)
+        largest = (size_t) 1 << order;
+    }
+  printf ("\nPalloc: %s %zu of %zu pages free, largest block %zu, "
+          "%zu%% fragmented\n", name, free_pages, pool->page_cnt, largest,
+          free_pages ? (free_pages - largest) * 100 / free_pages : 0);
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Returns the kernel address of POOL's page PAGE_IDX as a free
+   block. */
+static struct free_block *
+block_at (const struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Puts the block of 2**ORDER pages at PAGE_IDX on POOL's free
+   list for ORDER. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  list_push_front (&pool->free_lists[order], &block_at (pool, page_idx)->elem);
+  pool->free_cnt[order]++;
+  pool->order_map[page_idx] = order;
+}
+
+/* Takes the free block at PAGE_IDX, of the given ORDER, off its
+   free list. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->order_map[page_idx] == order);
+  list_remove (&block_at (pool, page_idx)->elem);
+  pool->free_cnt[order]--;
+  pool->order_map[page_idx] = NOT_FREE;
+}
+
+/* Returns the pool that PAGE belongs to. */
+static struct pool *
+pool_of (void *page)
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough.  Interrupts must be off. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int want = order_for (page_cnt);
+  int order;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (want > MAX_ORDER)
+    return BITMAP_ERROR;
+
+  for (order = want; order <= MAX_ORDER; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order > MAX_ORDER)
+    return BITMAP_ERROR;
+
+  page_idx = pg_no (list_front (&pool->free_lists[order])) - pg_no (pool->base);
+  remove_block (pool, page_idx, order);
+
+  /* Split down to the order we want, keeping the lower half. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+      split_cnt++;
+    }
+
+  ASSERT (!bitmap_contains (pool->used_map, page_idx, (size_t) 1 << want, true));
+  bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << want, true);
+
+  /* Give back the pages past PAGE_CNT. */
+  if (((size_t) 1 << want) > page_cnt)
+    buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
+
+/* Takes free page PAGE_IDX out of the free block that contains
+   it, putting the rest of that block back as smaller blocks. */
+static void
+claim_page (struct pool *pool, size_t page_idx)
+{
+  size_t head = page_idx;
+  int order;
+
+  /* Free blocks are aligned to their size, so the one holding
+     PAGE_IDX starts at PAGE_IDX rounded down to its order. */
+  for (order = 0; order <= MAX_ORDER; order++)
+    {
+      head = page_idx & ~(((size_t) 1 << order) - 1);
+      if (pool->order_map[head] == order)
+        break;
+    }
+  ASSERT (order <= MAX_ORDER);
+  remove_block (pool, head, order);
+
+  /* Split, keeping the half with PAGE_IDX each time. */
+  while (order > 0)
+    {
+      size_t half = (size_t) 1 << --order;
+      if (page_idx < head + half)
+        push_block (pool, head + half, order);
+      else
+        {
+          push_block (pool, head, order);
+          head += half;
+        }
+      split_cnt++;
+    }
+}
+
+/* Allocates the PAGE_CNT specific pages starting at PAGE_IDX
+   from POOL, if they are all free.  Returns true if successful.
+   Interrupts must be off. */
+static bool
+buddy_claim (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (page_idx + page_cnt > pool->page_cnt
+      || bitmap_contains (pool->used_map, page_idx, page_cnt, true))
+    return false;
+
+  for (i = 0; i < page_cnt; i++)
+    claim_page (pool, page_idx + i);
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  return true;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX into POOL,
+   merging it with its buddy as far as possible. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  while (order < MAX_ORDER)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->order_map[buddy] != order)
+        break;
+      remove_block (pool, buddy, order);
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+      merge_cnt++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX into POOL, as the
+   largest aligned blocks the range is made of.  Interrupts must
+   be off. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order < MAX_ORDER
+             && (page_idx & ((size_t) 1 << order)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Pops a page off POOL's zero stack and returns it, all zeros,
+   or returns a null pointer if the stack is empty. */
+static void *
+pop_zero_page (struct pool *pool)
+{
+  struct zero_page *zp;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  zp = pool->zero_pages;
+  if (zp != NULL)
+    {
+      pool->zero_pages = zp->next;
+      pool->zero_cnt--;
+    }
+  intr_set_level (old_level);
+
+  if (zp != NULL)
+    zp->next = NULL;
+  return zp;
+}
+
+/* Gives every page on POOL's zero stack back to the buddy
+   system.  Interrupts must be off.  Returns true if any page was
+   freed. */
+static bool
+drain_zero_pages (struct pool *pool)
+{
+  struct zero_page *zp;
+  bool freed = false;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  while ((zp = pop_zero_page (pool)) != NULL)
+    {
+      buddy_free (pool, pg_no (zp) - pg_no (pool->base), 1);
+      freed = true;
+    }
+  return freed;
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map, order map and owner map at
+     its base.  Calculate the space needed for them and subtract
+     it from the pool's size. */
+  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt)
+                                  + page_cnt * (1 + sizeof (void *)),
+                                  PGSIZE);
+  size_t bm_bytes = bitmap_buf_size (page_cnt);
+  enum intr_level old_level;
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +612,26 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_bytes);
+  p->owner_map = (void **) ((uint8_t *) base + bm_bytes);
+  p->order_map = (uint8_t *) (p->owner_map + page_cnt);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  for (order = 0; order <= MAX_ORDER; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+  memset (p->order_map, NOT_FREE, page_cnt);
+  memset (p->owner_map, 0, page_cnt * sizeof *p->owner_map);
+  p->zero_pages = NULL;
+  p->zero_cnt = 0;
+
+  /* Hand every page to the buddy system. */
+  bitmap_set_all (p->used_map, true);
+  old_level = intr_disable ();
+  buddy_free (p, 0, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Returns true if PAGE was allocated from POOL,
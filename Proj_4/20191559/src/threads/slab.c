@@ -0,0 +1,318 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   malloc() rounds every request up to a power of 2, so a 52-byte
+   structure takes a 64-byte block, and all allocations of a size
+   class contend on one lock.  A slab cache instead serves objects
+   of a single, exact size for one kind of structure.
+
+   A cache carves page-sized "slabs" into as many objects as fit
+   after a small header.  Free objects in a slab are chained
+   through their first word.  Slabs with both free and used
+   objects are kept on the cache's partial list, which allocation
+   tries first, so objects stay packed into few pages.
+
+   A slab whose last object is freed is kept on the empty list,
+   up to MAX_EMPTY_SLABS per cache, so that a burst of frees and
+   allocations does not bounce pages to and from the page
+   allocator.  slab_reclaim() gives all empty slabs back; it is
+   called when the kernel pool runs out of pages.
+
+   If a cache has a constructor, it runs on each object as the
+   object is handed out by slab_alloc(). */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Empty slabs a cache keeps before giving pages back. */
+#define MAX_EMPTY_SLABS 2
+
+/* Object cache. */
+struct slab_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of each object in bytes. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    slab_ctor_func *ctor;       /* Constructor, or null. */
+    struct list partial_slabs;  /* Slabs with free and used objects. */
+    struct list full_slabs;     /* Slabs with no free object. */
+    struct list empty_slabs;    /* Slabs with no used object. */
+    size_t empty_cnt;           /* Number of empty slabs. */
+    struct lock lock;           /* Lock. */
+    struct list_elem elem;      /* Element in cache list. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs owned by this cache. */
+    size_t in_use;              /* Objects handed out. */
+    size_t peak_in_use;         /* Largest IN_USE seen. */
+    long long alloc_cnt;        /* # of slab_alloc() calls served. */
+    long long reclaim_cnt;      /* # of empty slabs given back. */
+  };
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    size_t in_use;              /* Objects handed out from this slab. */
+    void *free;                 /* First free object, or null. */
+  };
+
+/* Every cache, for slab_reclaim() and statistics. */
+static struct list caches;
+static struct lock caches_lock;
+
+static struct slab *new_slab (struct slab_cache *);
+static struct slab *obj_to_slab (void *);
+static size_t release_empty_slabs (struct slab_cache *, size_t keep);
+
+/* Initializes the object cache list. */
+void
+slab_init (void)
+{
+  list_init (&caches);
+  lock_init (&caches_lock);
+}
+
+/* Creates and returns a cache named NAME for objects of OBJ_SIZE
+   bytes.  If CTOR is nonnull, it initializes each object that
+   slab_alloc() returns.  Panics if memory is not available,
+   since caches are created at boot. */
+struct slab_cache *
+slab_cache_create (const char *name, size_t obj_size, slab_ctor_func *ctor)
+{
+  struct slab_cache *c;
+
+  /* Objects must hold the free list link and keep it aligned. */
+  obj_size = ROUND_UP (obj_size < sizeof (void *) ? sizeof (void *) : obj_size,
+                       sizeof (void *));
+  ASSERT (obj_size <= PGSIZE - sizeof (struct slab));
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("slab_cache_create: out of memory for %s", name);
+
+  c->name = name;
+  c->obj_size = obj_size;
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / obj_size;
+  c->ctor = ctor;
+  list_init (&c->partial_slabs);
+  list_init (&c->full_slabs);
+  list_init (&c->empty_slabs);
+  c->empty_cnt = 0;
+  lock_init (&c->lock);
+  c->slab_cnt = c->in_use = c->peak_in_use = 0;
+  c->alloc_cnt = c->reclaim_cnt = 0;
+
+  lock_acquire (&caches_lock);
+  list_push_back (&caches, &c->elem);
+  lock_release (&caches_lock);
+  return c;
+}
+
+/* Obtains and returns an object from cache C.
+   Returns a null pointer if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial_slabs))
+    s = list_entry (list_front (&c->partial_slabs), struct slab, elem);
+  else if (!list_empty (&c->empty_slabs))
+    {
+      s = list_entry (list_pop_front (&c->empty_slabs), struct slab, elem);
+      c->empty_cnt--;
+      list_push_front (&c->partial_slabs, &s->elem);
+    }
+  else
+    {
+      /* Get a page without holding our lock, since running short
+         makes us reclaim from every cache, this one included. */
+      lock_release (&c->lock);
+      s = new_slab (c);
+      if (s == NULL)
+        return NULL;
+      lock_acquire (&c->lock);
+      c->slab_cnt++;
+      list_push_front (&c->partial_slabs, &s->elem);
+    }
+
+  /* Take the slab's first free object. */
+  obj = s->free;
+  s->free = *(void **) obj;
+  if (++s->in_use == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full_slabs, &s->elem);
+    }
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  c->alloc_cnt++;
+  lock_release (&c->lock);
+
+  if (c->ctor != NULL)
+    c->ctor (obj);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C with
+   slab_alloc(), to C.  A null OBJ is ignored. */
+void
+slab_free (struct slab_cache *c, void *obj)
+{
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (obj);
+  ASSERT (s->cache == c);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs. */
+  memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->in_use > 0);
+  if (s->in_use-- == c->objs_per_slab)
+    {
+      /* Was full, now partial. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial_slabs, &s->elem);
+    }
+  *(void **) obj = s->free;
+  s->free = obj;
+  c->in_use--;
+
+  if (s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->empty_slabs, &s->elem);
+      c->empty_cnt++;
+      release_empty_slabs (c, MAX_EMPTY_SLABS);
+    }
+  lock_release (&c->lock);
+}
+
+/* Gives every empty slab of every cache back to the page
+   allocator.  Returns the number of pages freed. */
+size_t
+slab_reclaim (void)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+
+  lock_acquire (&caches_lock);
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+
+      lock_acquire (&c->lock);
+      freed += release_empty_slabs (c, 0);
+      lock_release (&c->lock);
+    }
+  lock_release (&caches_lock);
+  return freed;
+}
+
+/* Prints occupancy statistics for every cache. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+      size_t capacity = c->slab_cnt * c->objs_per_slab;
+
+      printf ("Slab: %s: %zu of %zu objects in use (peak %zu), "
+              "%zu slabs of %zu x %zu bytes, %lld allocs, %lld reclaimed\n",
+              c->name, c->in_use, capacity, c->peak_in_use, c->slab_cnt,
+              c->objs_per_slab, c->obj_size, c->alloc_cnt, c->reclaim_cnt);
+    }
+}
+
+/* Obtains a page for cache C and carves it into free objects.
+   Returns the new slab, or a null pointer if memory is not
+   available even after reclaiming empty slabs. */
+static struct slab *
+new_slab (struct slab_cache *c)
+{
+  struct slab *s;
+  uint8_t *obj;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL && slab_reclaim () > 0)
+    s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+  s->free = NULL;
+
+  /* Chain the objects so the lowest address is handed out first. */
+  obj = (uint8_t *) (s + 1) + c->objs_per_slab * c->obj_size;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      obj -= c->obj_size;
+      *(void **) obj = s->free;
+      s->free = obj;
+    }
+  return s;
+}
+
+/* Returns the slab that OBJ is inside. */
+static struct slab *
+obj_to_slab (void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and OBJ is aligned in it. */
+  ASSERT (s != NULL);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (((uint8_t *) obj - (uint8_t *) (s + 1)) % s->cache->obj_size == 0);
+
+  return s;
+}
+
+/* Frees empty slabs of cache C until at most KEEP are left.
+   C's lock must be held.  Returns the number of slabs freed. */
+static size_t
+release_empty_slabs (struct slab_cache *c, size_t keep)
+{
+  size_t freed = 0;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  while (c->empty_cnt > keep)
+    {
+      struct slab *s = list_entry (list_pop_back (&c->empty_slabs),
+                                   struct slab, elem);
+      c->empty_cnt--;
+      c->slab_cnt--;
+      c->reclaim_cnt++;
+      s->magic = 0;
+      palloc_free_page (s);
+      freed++;
+    }
+  return freed;
+}
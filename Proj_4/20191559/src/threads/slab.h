@@ -0,0 +1,20 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object cache.  Opaque; see slab.c. */
+struct slab_cache;
+
+/* Object constructor. */
+typedef void slab_ctor_func (void *obj);
+
+void slab_init (void);
+struct slab_cache *slab_cache_create (const char *name, size_t obj_size,
+                                      slab_ctor_func *);
+void *slab_alloc (struct slab_cache *) __attribute__ ((malloc));
+void slab_free (struct slab_cache *, void *);
+size_t slab_reclaim (void);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
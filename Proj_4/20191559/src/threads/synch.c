@@ -37,6 +37,41 @@
 #define FOR_LIST(e, list) \
     for ((e) = list_begin(list); (e) != list_end(list); (e) = list_next(e))
 
+/* Priority donation.
+
+   A thread that blocks on a lock donates its priority to the
+   lock's holder, and if the holder is itself waiting for a lock,
+   on to that lock's holder, and so on, up to DONATION_DEPTH_MAX
+   locks.  A thread's effective priority is the highest of its
+   base priority and the priorities of the threads waiting on the
+   locks it holds, so releasing a lock drops exactly the
+   donations that came through it.
+
+   Donation does not apply to the MLFQS or aging schedulers,
+   which compute every priority themselves. */
+#define DONATION_DEPTH_MAX 8
+
+/* Donation statistics. */
+static long long donation_cnt;  /* # of lock_acquire()s that donated. */
+static long long nested_cnt;    /* # that donated through 2+ locks. */
+static int deepest_chain;       /* Most locks one donation went through. */
+
+static void donate_priority (struct lock *);
+static heap_less_func waiter_higher;
+static heap_less_func cond_waiter_higher;
+
+/* Sequence number for the next waiter, so that waiters of equal
+   priority wake up in the order they started waiting. */
+static uint64_t next_wait_seq;
+
+/* Returns true if priorities come from donation, false if the
+   scheduler computes them. */
+static inline bool
+donation_enabled (void) 
+{
+  return !thread_mlfqs && !thread_aging;
+}
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -45,14 +80,19 @@
      decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-     thread, if any). */
+     thread, if any).
+
+   Waiting threads are kept in a heap ordered by priority, and by
+   arrival among equal priorities, so that "up" wakes the
+   highest-priority waiter in O(log n) time with interrupts off,
+   however many threads wait. */
 void
 sema_init (struct semaphore *sema, unsigned value) 
 {
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, waiter_higher, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -73,7 +113,11 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+
+      cur->wait_seq = next_wait_seq++;
+      cur->waiting_sema = sema;
+      heap_push (&sema->waiters, &cur->wait_elem);
       thread_block ();
     }
   sema->value--;
@@ -106,19 +150,6 @@ sema_try_down (struct semaphore *sema)
   return success;
 }
 
-struct thread* find_highest_priority_thread(struct list* waiters) {
-  struct list_elem *e;
-  struct thread *highest_priority = NULL;
-  struct thread *t;
-
-  FOR_LIST(e, waiters) {
-    t = list_entry(e, struct thread, elem);
-    if (highest_priority == NULL || t->priority > highest_priority->priority) highest_priority = t;  
-  }
-
-  return highest_priority;
-}
-
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
 
@@ -131,10 +162,11 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) {
-    struct thread* highest_priority = find_highest_priority_thread(&sema->waiters);
-    list_remove(&highest_priority->elem);
-    thread_unblock(highest_priority);
+  if (!heap_empty (&sema->waiters)) {
+    struct thread *t = heap_entry (heap_pop (&sema->waiters),
+                                   struct thread, wait_elem);
+    t->waiting_sema = NULL;
+    thread_unblock(t);
   }
   sema->value++;
   intr_set_level (old_level);
@@ -207,6 +239,23 @@ lock_init (struct lock *lock)
   sema_init (&lock->semaphore, 1);
 }
 
+/* Adds LOCK to the current thread's held locks and makes it the
+   holder.  Threads still waiting on LOCK now donate to us.  Must
+   be called with interrupts off. */
+static void
+lock_take (struct lock *lock) 
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+  if (donation_enabled ())
+    lock_refresh_priority (cur);
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -218,12 +267,22 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->holder != NULL)
+    {
+      thread_current ()->waiting_lock = lock;
+      if (donation_enabled ())
+        donate_priority (lock);
+    }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  lock_take (lock);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -235,14 +294,17 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    lock_take (lock);
+  intr_set_level (old_level);
   return success;
 }
 
@@ -254,11 +316,25 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* Give back the donations that came through LOCK before waking
+     its highest-priority waiter, then yield if that waiter, or
+     any other ready thread, now outranks us.  sema_up() does not
+     yield by itself in a USERPROG kernel. */
+  old_level = intr_disable ();
   lock->holder = NULL;
+  list_remove (&lock->elem);
+  if (donation_enabled ())
+    lock_refresh_priority (thread_current ());
+  intr_set_level (old_level);
+
   sema_up (&lock->semaphore);
+  if (!intr_context () && thread_current ()->priority < get_max_priority ())
+    thread_yield ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -271,23 +347,214 @@ lock_held_by_current_thread (const struct lock *lock)
 
   return lock->holder == thread_current ();
 }
+
+/* Donates the current thread's priority, as it starts waiting for
+   LOCK, along the chain of lock holders.  Stops at a holder that
+   already has at least that priority, since donation has then
+   already passed that point.  Must be called with interrupts
+   off. */
+static void
+donate_priority (struct lock *lock) 
+{
+  int priority = thread_current ()->priority;
+  int depth = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (lock != NULL && lock->holder != NULL && depth < DONATION_DEPTH_MAX)
+    {
+      struct thread *holder = lock->holder;
+
+      if (holder->priority >= priority)
+        break;
+      thread_change_priority (holder, priority);
+      depth++;
+      lock = holder->waiting_lock;
+    }
+
+  if (depth > 0)
+    {
+      donation_cnt++;
+      if (depth > 1)
+        nested_cnt++;
+      if (depth > deepest_chain)
+        deepest_chain = depth;
+    }
+}
+
+/* Recomputes T's effective priority as the highest of its base
+   priority and the priorities of the threads waiting on the locks
+   it holds.  Must be called with interrupts off. */
+void
+lock_refresh_priority (struct thread *t) 
+{
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  FOR_LIST (e, &t->held_locks)
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      struct heap_elem *top = heap_top (&lock->semaphore.waiters);
+
+      if (top != NULL)
+        {
+          struct thread *waiter = heap_entry (top, struct thread, wait_elem);
+          if (waiter->priority > priority)
+            priority = waiter->priority;
+        }
+    }
+  thread_change_priority (t, priority);
+}
+
+/* Prints priority donation statistics. */
+void
+lock_print_stats (void) 
+{
+  printf ("Locks: %lld priority donations, %lld nested, "
+          "deepest chain %d locks\n",
+          donation_cnt, nested_cnt, deepest_chain);
+}
 
-/* One semaphore in a list. */
+/* Initializes readers-writer lock RW.  Any number of threads may
+   hold RW for reading at once, or a single thread may hold it for
+   writing.
+
+   A writer first acquires RW's internal lock, then waits for the
+   readers inside to leave, and keeps the lock until it is done.
+   A reader acquires the same lock only long enough to count
+   itself in.  So:
+
+   - Writers are preferred: once a writer arrives, new readers
+     queue behind it instead of overtaking it, and readers cannot
+     starve writers.
+
+   - Readers and writers waiting on the internal lock are woken
+     in priority order, and donate their priority to the writer
+     holding it, nested as usual.
+
+   - A writer waiting for readers to leave does not donate to
+     them, since readers are not tracked individually.  Read-side
+     critical sections should therefore be short.
+
+   RW is not recursive: a thread must not acquire it for reading
+   or writing while it already holds it. */
+void
+rwlock_init (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  rw->readers = 0;
+  rw->writer_waiting = false;
+  sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping while a thread holds it for
+   writing or is waiting to.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  old_level = intr_disable ();
+  rw->readers++;
+  intr_set_level (old_level);
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   The last reader out lets a waiting writer in. */
+void
+rwlock_release_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0 && rw->writer_waiting)
+    sema_up (&rw->drained);
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it for reading or writing.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  old_level = intr_disable ();
+  if (rw->readers > 0)
+    {
+      rw->writer_waiting = true;
+      sema_down (&rw->drained);
+      rw->writer_waiting = false;
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing.
+   The highest-priority waiting reader or writer goes next. */
+void
+rwlock_release_write (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  return lock_held_by_current_thread (&rw->lock);
+}
+
+/* One thread waiting on a condition variable. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Element in condition's waiters. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct condition *cond;             /* Condition waited on. */
+    struct thread *thread;              /* Waiting thread. */
+    uint64_t seq;                       /* Orders equal-priority waiters. */
   };
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
-   code to receive the signal and act upon it. */
+   code to receive the signal and act upon it.
+
+   Like a semaphore's, COND's waiters are kept in a heap by
+   priority, so signaling wakes the highest-priority waiter. */
 void
 cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, cond_waiter_higher, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -314,6 +581,7 @@ void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -321,7 +589,17 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.cond = cond;
+  waiter.thread = thread_current ();
+
+  /* Priority changes reorder COND's waiters from interrupt
+     context, so even with LOCK held they need interrupts off. */
+  old_level = intr_disable ();
+  waiter.seq = next_wait_seq++;
+  heap_push (&cond->waiters, &waiter.elem);
+  waiter.thread->cond_waiter = &waiter;
+  intr_set_level (old_level);
+
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
@@ -342,9 +620,19 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  if (!heap_empty (&cond->waiters)) 
+    {
+      struct semaphore_elem *waiter;
+      enum intr_level old_level;
+
+      old_level = intr_disable ();
+      waiter = heap_entry (heap_pop (&cond->waiters),
+                           struct semaphore_elem, elem);
+      waiter->thread->cond_waiter = NULL;
+      intr_set_level (old_level);
+
+      sema_up (&waiter->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -359,6 +647,48 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Moves T, whose priority just changed, to its new place among
+   the waiters of the semaphore and condition variable it waits
+   on, if any.  Must be called with interrupts off. */
+void
+sema_requeue_waiter (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->waiting_sema != NULL)
+    heap_update (&t->waiting_sema->waiters, &t->wait_elem);
+  if (t->cond_waiter != NULL)
+    heap_update (&t->cond_waiter->cond->waiters, &t->cond_waiter->elem);
+}
+
+/* Returns true if waiting thread A should wake up before B: it
+   has higher priority, or equal priority and waited longer. */
+static bool
+waiter_higher (const struct heap_elem *a_, const struct heap_elem *b_,
+               void *aux UNUSED) 
+{
+  const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+  const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+  if (a->priority != b->priority)
+    return a->priority > b->priority;
+  return a->wait_seq < b->wait_seq;
+}
+
+/* Returns true if condition variable waiter A should be signaled
+   before B, by the same rule as waiter_higher(). */
+static bool
+cond_waiter_higher (const struct heap_elem *a_, const struct heap_elem *b_,
+                    void *aux UNUSED) 
+{
+  const struct semaphore_elem *a = heap_entry (a_, struct semaphore_elem, elem);
+  const struct semaphore_elem *b = heap_entry (b_, struct semaphore_elem, elem);
+
+  if (a->thread->priority != b->thread->priority)
+    return a->thread->priority > b->thread->priority;
+  return a->seq < b->seq;
+}
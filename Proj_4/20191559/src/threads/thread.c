@@ -7,6 +7,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
@@ -31,9 +32,20 @@ static int load_avg; // Added in Proj #3
 #define THREAD_MAGIC 0xcd6abf4b
 #define FRACTION (1 << 14)
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue: processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+
+   There is one FIFO list per priority, and bit P of ready_mask
+   is set exactly when the list for priority P is nonempty.
+   Queueing a thread appends it to the list for its priority, and
+   the next thread to run is the front of the list named by the
+   highest set bit, so both take constant time.  A thread whose
+   priority changes while it is ready moves to the back of its
+   new list. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+static struct list ready_lists[PRI_CNT];
+static uint64_t ready_mask;
+static size_t ready_cnt;        /* Number of threads in the run queue. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -71,8 +83,6 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 bool thread_mlfqs;
 bool thread_aging; // Added in Proj #3
 
-extern struct list sleep_list;
-
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -80,6 +90,8 @@ static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
@@ -106,9 +118,8 @@ thread_init (void)
   load_avg = 0;
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  FOR_RANGE(p, PRI_MIN, PRI_MAX + 1) list_init (&ready_lists[p]);
   list_init (&all_list);
-  list_init (&sleep_list);
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
@@ -256,8 +267,7 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  // list_push_back (&ready_list, &t->elem);
-  list_insert_ordered(&ready_list, &t->elem, (list_less_func *) &comp_priority, NULL); // Added in Proj #3
+  ready_push (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
 }
@@ -305,6 +315,7 @@ thread_exit (void)
 #ifdef USERPROG
   process_exit ();
 #endif
+  malloc_thread_exit ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
@@ -317,12 +328,6 @@ thread_exit (void)
 }
 
 
-bool comp_priority(struct list_elem *a, struct list_elem *b, void *aux UNUSED){
-  struct thread *t1 = list_entry(a, struct thread, elem);
-  struct thread *t2 = list_entry(b, struct thread, elem);
-  return t1->priority > t2->priority;
-}
-
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
 void
@@ -335,7 +340,7 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_insert_ordered(&ready_list, &cur->elem, (list_less_func *) &comp_priority, NULL); // Added in Proj #3
+    ready_push (cur);
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -358,17 +363,53 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY.  The
+   thread keeps any higher priority donated to it through locks
+   it holds until it releases them.  Yields if a ready thread now
+   has a higher priority. */
 void
 thread_set_priority (int new_priority) 
 {
-  int old_priority = thread_current ()->priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   if(thread_mlfqs) return;
 
-  thread_current ()->priority = new_priority;
+  old_level = intr_disable ();
+  cur->base_priority = new_priority;
+  lock_refresh_priority (cur);
+  intr_set_level (old_level);
 
-  if (old_priority > new_priority) thread_yield(); // Added in Proj #3
+  if (cur->priority < get_max_priority()) thread_yield(); // Added in Proj #3
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue list if it is ready, or to its new place
+   among the waiters of a semaphore or condition variable if it
+   is blocked on one.  Used for priority donation; T's base
+   priority is unchanged. */
+void
+thread_change_priority (struct thread *t, int priority)
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_READY && t->priority != priority)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else if (t->priority != priority)
+    {
+      t->priority = priority;
+      if (t->status == THREAD_BLOCKED)
+        sema_requeue_waiter (t);
+    }
+  intr_set_level (old_level);
 }
 
 /* Returns the current thread's priority. */
@@ -413,7 +454,7 @@ thread_get_recent_cpu ()
 /* Updates Load Avg
    Added in #Proj. 3  */
 void update_load_avg() {
-    int ready_threads = list_size(&ready_list);
+    int ready_threads = ready_cnt;
     if (thread_current() != idle_thread) ready_threads++;
     load_avg = ((59 * load_avg) + (ready_threads * FRACTION)) / 60;
 }
@@ -437,11 +478,14 @@ void update_recent_cpu() {
 void update_thread_priority(struct thread *t) {
   int priority_base = PRI_MAX * FRACTION - t->recent_cpu / 4;
   int priority_nice = 2 * t->nice * FRACTION;
-  t->priority = (priority_base - priority_nice) / FRACTION;
+  int priority = (priority_base - priority_nice) / FRACTION;
 
   // Priority should be in range [PRI_MIN, PRI_MAX]
-  t->priority = t->priority > PRI_MAX ? PRI_MAX : t->priority;
-  t->priority = t->priority < PRI_MIN ? PRI_MIN : t->priority;
+  priority = priority > PRI_MAX ? PRI_MAX : priority;
+  priority = priority < PRI_MIN ? PRI_MIN : priority;
+
+  // A ready thread moves to the queue for its new priority
+  thread_change_priority(t, priority);
 }
 
 /* Update priority of all threads
@@ -475,10 +519,24 @@ idle (void *idle_started_ UNUSED)
 
   for (;;) 
     {
-      /* Let someone else run. */
+      bool zeroed;
+
+      /* Let someone else run.  If a tickless halt ended early,
+         first account for the ticks it skipped. */
       intr_disable ();
+      timer_idle_exit ();
       thread_block ();
 
+      /* Nobody else wants the CPU: spend it clearing a free page
+         for later PAL_ZERO requests.  Go back to the scheduler
+         after each page, so a thread that became ready meanwhile
+         runs right away. */
+      intr_enable ();
+      zeroed = palloc_prezero_page ();
+      intr_disable ();
+      if (zeroed || ready_mask != 0)
+        continue;
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -490,7 +548,11 @@ idle (void *idle_started_ UNUSED)
          time.
 
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
+         7.11.1 "HLT Instruction".
+
+         In tickless mode, the timer will not interrupt until the
+         next sleeper is due. */
+      timer_idle_enter ();
       asm volatile ("sti; hlt" : : : "memory");
     }
 }
@@ -544,7 +606,8 @@ init_thread (struct thread *t, const char *name, int priority)
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init (&t->held_locks);
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable();
@@ -557,6 +620,7 @@ init_thread (struct thread *t, const char *name, int priority)
   #ifdef USERPROG
     // Init File Descriptor
     FOR(i, 128) t->FD[i] = NULL;
+    t->cwd = NULL;
     t->parent = running_thread();
 
     sema_init(&(t->child_lock), 0);
@@ -568,19 +632,40 @@ init_thread (struct thread *t, const char *name, int priority)
   #endif
 }
 
-/* Get max priority in ready_list 
+/* Get max priority in the run queue, or -1 if it is empty
    Added in #Proj. 3  */
 int get_max_priority() {
-    int max_priority = -1;
-    struct thread *t;
+    uint32_t high = ready_mask >> 32, low = ready_mask;
 
-    // Find max priority in ready_list by traversing
-    struct list_elem *e;
-    FOR_LIST(e, &ready_list) {
-        t = list_entry(e, struct thread, elem);
-        if (t->priority > max_priority) max_priority = t->priority;
-    }
-    return max_priority;
+    // Highest set bit of the mask, one 32-bit bsr at a time
+    if (high != 0) return 32 + (31 - __builtin_clz(high));
+    if (low != 0) return 31 - __builtin_clz(low);
+    return -1;
+}
+
+/* Appends T to the run queue list for its priority.
+   Must be called with interrupts off. */
+static void
+ready_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&ready_lists[t->priority], &t->elem);
+  ready_mask |= (uint64_t) 1 << t->priority;
+  ready_cnt++;
+}
+
+/* Removes T, which must be in the run queue, from it.
+   Must be called with interrupts off. */
+static void
+ready_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_lists[t->priority]))
+    ready_mask &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
 }
 
 
@@ -606,10 +691,15 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  struct thread *t;
+
+  if (ready_mask == 0)
     return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+
+  t = list_entry (list_front (&ready_lists[get_max_priority ()]),
+                  struct thread, elem);
+  ready_remove (t);
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
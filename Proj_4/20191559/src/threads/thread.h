@@ -2,6 +2,7 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
 #include "synch.h"
@@ -78,12 +79,11 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c).
+   A thread waiting on a semaphore is instead in the semaphore's
+   waiter heap through `wait_elem' (synch.c), which keeps its own
+   member so that synch.c can reorder the heap when the waiting
+   thread's priority changes. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -91,12 +91,24 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, including donations. */
     struct list_elem allelem;           /* List element for all threads list. */
 
+    /* Shared between thread.c and synch.c. */
+    int base_priority;                  /* Priority without donations. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being acquired, or null. */
+    struct heap_elem wait_elem;         /* Element in semaphore's waiters. */
+    uint64_t wait_seq;                  /* Orders equal-priority waiters. */
+    struct semaphore *waiting_sema;     /* Semaphore waited on, or null. */
+    struct semaphore_elem *cond_waiter; /* Condition wait, or null. */
+
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by threads/malloc.c. */
+    struct magazine *magazines;         /* Per-thread block caches. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
@@ -112,6 +124,7 @@ struct thread
     struct semaphore load_lock;       /* Lock of load */
 
     struct file* FD[128];             /* File Descriptor */
+    struct dir *cwd;                  /* Working directory, null for root */
 #endif
 
     /* Owned by thread.c. */
@@ -119,11 +132,14 @@ struct thread
 
    /* Added in #Proj 3 */
    int64_t wake_time;                 /* Time ticks to wakeup */   
+   uint64_t sleep_seq;                /* Orders sleepers with equal wake_time */
+   struct heap_elem sleep_elem;       /* Element in timer.c's sleepers heap */
    int64_t recent_cpu;                /* Recent CPU time */
    int64_t nice;                      /* Nice value */
 
    /* Added in #Proj 4 */
     struct hash vm;
+    bool vm_exiting;                  /* Set once process_exit() frees vm. */
   };
 
 /* If false (default), use round-robin scheduler.
@@ -163,13 +179,12 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-bool comp_priority(struct list_elem *a, struct list_elem *b, void *aux UNUSED);
-
 /* Added in #Proj. 3  */
 void update_load_avg();
 void update_recent_cpu();
 void update_all_priority();
 void update_thread_priority(struct thread *t);
+void thread_change_priority (struct thread *, int priority);
 int get_max_priority();
 
 /* Added in #Proj 4: var for VM */
@@ -8,6 +8,7 @@
 #include "userprog/process.h"
 
 #include "vm/page.h"
+#include "vm/ksm.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -158,10 +159,13 @@ page_fault (struct intr_frame *f)
   user = (f->error_code & PF_U) != 0;
    
   	VERIFY_ADDR(fault_addr);
-	// Check for page presence and handle absence
-   if (!not_present) EXIT(-1);
-
    struct virtual_page_entr *page_entr = get_virtual_page_entr_by_vaddr(fault_addr);
+
+	// A write to a present page is only legal on a KSM-shared frame
+   if (!not_present) {
+      if (!write || !page_entr || !ksm_break_cow(page_entr)) EXIT(-1);
+      return;
+   }
    bool load_success;
 
    if (!page_entr) {
@@ -21,6 +21,7 @@
 #include "vm/page.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
+#include "vm/ksm.h"
 
 #define FOR(i, n) for(int i=0; i<n; i++)
 #define FOR1(i, n) for(int i=1; i<=n; i++)
@@ -50,7 +51,7 @@ bool expand_stack(void *addr) {
   if (!vme) return false;
   struct page *stack_page = allocate_and_setup_page(vme);
   if (!stack_page) {
-    free(vme);
+    slab_free(vme_cache, vme);
     return false;
   }
 
@@ -62,12 +63,14 @@ bool is_valid_stack_expansion(void *addr) {
 }
 
 struct virtual_page_entry *create_virtual_page_entry(void *addr) {
-    struct virtual_page_entr *vme = malloc(sizeof(struct virtual_page_entr));
+    struct virtual_page_entr *vme = slab_alloc(vme_cache);
     if (!vme) return NULL;
 
     vme->is_in_memory = vme->is_writable = true;
     vme->type = false; 
     vme->vaddr = addr;
+    vme->backing_file = NULL;
+    vme->ksm_frame = NULL;
     return vme;
 }
 
@@ -79,7 +82,6 @@ struct page *allocate_and_setup_page(struct virtual_page_entr *vme) {
 
     if (!install_page(vme->vaddr, stack_page->kernel_addr, vme->is_writable)) {
         free_and_remove_page(stack_page->kernel_addr);
-        free(stack_page);
         return NULL;
     }
     return stack_page;
@@ -88,8 +90,7 @@ struct page *allocate_and_setup_page(struct virtual_page_entr *vme) {
 bool add_page_to_process_vm(struct virtual_page_entr *vme, struct page *stack_page) {
     if (!add_virtual_page_entr(&thread_current()->vm, vme)) {
         free_and_remove_page(stack_page->kernel_addr);
-        free(stack_page);
-        free(vme);
+        slab_free(vme_cache, vme);
         return false;
     }
     return true;
@@ -173,6 +174,10 @@ start_process (void *file_name_)
   bool success;
   
   hash_init(&(thread_current()->vm), hash_virtual_page_entr, smaller_virtual_page_entr, NULL);
+
+  // Inherit the working directory; the parent waits on load_lock meanwhile
+  struct thread *parent = thread_current()->parent;
+  if (parent->cwd != NULL) thread_current()->cwd = dir_reopen(parent->cwd);
   
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -233,11 +238,13 @@ process_wait (tid_t child_tid UNUSED)
 
 static void destroy_vm(struct hash_elem *elem, void *aux UNUSED) {
 	struct virtual_page_entr *e = hash_entry(elem, struct virtual_page_entr, elem);
-    if (e->is_in_memory) {
+    if (e->ksm_frame) {
+        ksm_unmap(e);
+    } else if (e->is_in_memory) {
         free_and_remove_page(pagedir_get_page(thread_current()->pagedir, e->vaddr));
         pagedir_clear_page(thread_current()->pagedir, e->vaddr);
     }
-    free(e);
+    slab_free(vme_cache, e);
 }
 
 /* Free the current process's resources. */
@@ -247,6 +254,10 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
   /* Added in #Proj 4 */
+  /* Keep the KSM scanner away from pages we are about to free. */
+  lock_acquire(&lru_lock);
+  cur->vm_exiting = true;
+  lock_release(&lru_lock);
   hash_destroy(&cur->vm, destroy_vm);
 
   /* Destroy the current process's page directory and switch back
@@ -268,6 +279,8 @@ process_exit (void)
     FOR_RANGE(i, 2, 128) {
       if(cur->FD[i] != NULL) file_close(cur->FD[i]);
     }
+    dir_close(cur->cwd);
+    cur->cwd = NULL;
 
     sema_up(&(cur->child_lock));
     sema_down(&(cur->mem_lock));
@@ -617,6 +630,7 @@ static bool initialize_vm_entry(struct virtual_page_entr *entry, struct file *fi
     entry->zero_bytes = zero_bytes;
     entry->file_offset = ofs;
     entry->is_writable = writable;
+    entry->ksm_frame = NULL;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -650,14 +664,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
          and zero the final PAGE_ZERO_BYTES bytes. */
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
-      struct virtual_page_entr *entry = malloc(sizeof(struct virtual_page_entr));
+      struct virtual_page_entr *entry = slab_alloc(vme_cache);
       
       if (!entry) return false;
       
       initialize_vm_entry(entry, reopen_file, upage, ofs, page_read_bytes, page_zero_bytes, writable);
       
       if (!add_virtual_page_entr(&thread_current()->vm, entry)) {
-          free(entry);
+          slab_free(vme_cache, entry);
           return false;
       }
       
@@ -678,12 +692,14 @@ static bool allocate_stack_page(struct page **kpage, void **virtual_address) {
 }
 
 static bool initialize_stack_vme(struct virtual_page_entr **vme, void *virtual_address) {
-  *vme = malloc(sizeof(struct virtual_page_entr));
+  *vme = slab_alloc(vme_cache);
   if (*vme == NULL) return false;
   
   (*vme)->vaddr = pg_round_down(virtual_address);
   (*vme)->is_in_memory = (*vme)->is_writable = true;
   (*vme)->type = false; 
+  (*vme)->backing_file = NULL;
+  (*vme)->ksm_frame = NULL;
   return true;
 }
 
@@ -9,8 +9,10 @@
 #include "threads/synch.h"
 #include "devices/input.h"
 #include "devices/shutdown.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
 #include "filesys/off_t.h"
 
 #include "vm/page.h"
@@ -19,7 +21,6 @@
 #define FOR1(i, n) for(int i=1; i<=n; i++)
 #define FOR_RANGE(i, start, end) for(int i = start; i < end; i++)
 typedef int32_t off_t;
-struct lock lock_file;
 
 #define VERIFY_ADDR(ADDR) \
     do { \
@@ -51,7 +52,6 @@ struct file {
 void
 syscall_init (void) 
 {
-  lock_init(&lock_file);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -112,6 +112,26 @@ syscall_handler (struct intr_frame *f UNUSED)
       VERIFY_ADDR(f->esp + 4);
       CLOSE(*(uint32_t *)(f->esp + 4)); //
       break;
+    case SYS_CHDIR:
+      VERIFY_ADDR(f->esp + 4);
+      f->eax = CHDIR((const char *) *(uint32_t *)(f->esp + 4));
+      break;
+    case SYS_MKDIR:
+      VERIFY_ADDR(f->esp + 4);
+      f->eax = MKDIR((const char *) *(uint32_t *)(f->esp + 4));
+      break;
+    case SYS_READDIR:
+      VERIFY_ADDR(f->esp + 8);
+      f->eax = READDIR(*(uint32_t *)(f->esp + 4), (char *) *(uint32_t *)(f->esp + 8));
+      break;
+    case SYS_ISDIR:
+      VERIFY_ADDR(f->esp + 4);
+      f->eax = ISDIR(*(uint32_t *)(f->esp + 4));
+      break;
+    case SYS_INUMBER:
+      VERIFY_ADDR(f->esp + 4);
+      f->eax = INUMBER(*(uint32_t *)(f->esp + 4));
+      break;
     case SYS_FIBONACCI:
       f->eax = FIBONACCI(*(uint32_t *)(f->esp + 4)); //
       break;
@@ -142,9 +162,7 @@ int WAIT (int pid) {
 
 bool CREATE (const char *file, unsigned size) {
   if(!file) EXIT(-1);
-  lock_acquire(&lock_file);
   bool result = filesys_create(file, size);
-  lock_release(&lock_file);
 
   return result;
 }
@@ -158,11 +176,9 @@ int OPEN (const char *file) {
   // Check file validation
   if(!file) EXIT(-1);
   VERIFY_ADDR(file);
-  lock_acquire(&lock_file);
   struct file *f = filesys_open(file);
   int res = -1;
   if (!f) {
-    lock_release(&lock_file);
     return res;
   }
   // Find empty FD and OPEN
@@ -170,11 +186,9 @@ int OPEN (const char *file) {
     if (!thread_current()->FD[i]) {
       if(!strcmp(thread_current()->name, file)) file_deny_write(f);
       thread_current()->FD[i] = f;
-      lock_release(&lock_file);
       return res = i;
     }
   }
-  lock_release(&lock_file);
   return res;
 }
 
@@ -190,14 +204,11 @@ int READ (int fd, void *buffer, unsigned size) {
   if(!thread_current()->FD[fd]) EXIT(-1);
   VERIFY_ADDR(buffer);
   if (!fd) {
-    lock_acquire(&lock_file);
     FOR(i, size) *((uint8_t *)buffer + i) = input_getc();
-    lock_release(&lock_file);
     return size;
   } else if (fd > 2) {
-    lock_acquire(&lock_file);
+    if (ISDIR(fd)) return -1;
     int res = file_read(thread_current()->FD[fd], buffer, size);
-    lock_release(&lock_file);
     return res;
   } else return -1;
 }
@@ -206,15 +217,12 @@ int WRITE (int fd, const void *buffer, unsigned size) {
   if(!buffer) EXIT(-1);
   VERIFY_ADDR(buffer);
   if (fd == 1) {
-    lock_acquire(&lock_file);
     putbuf(buffer, size);
-    lock_release(&lock_file);
     return size;
   } else if (fd > 2) {
     if(!thread_current()->FD[fd]) EXIT(-1); 
-    lock_acquire(&lock_file);
+    if (ISDIR(fd)) return -1;
     int res = file_write(thread_current()->FD[fd], buffer, size);
-    lock_release(&lock_file);
     return res;
   } else return -1;
 }
@@ -238,6 +246,42 @@ void CLOSE (int fd){
   return file_close(fp);
 }
 
+bool CHDIR (const char *dir) {
+  if(!dir) EXIT(-1);
+  VERIFY_ADDR(dir);
+  return filesys_chdir(dir);
+}
+
+bool MKDIR (const char *dir) {
+  if(!dir) EXIT(-1);
+  VERIFY_ADDR(dir);
+  return filesys_mkdir(dir);
+}
+
+bool READDIR (int fd, char *name) {
+  if(!name) EXIT(-1);
+  VERIFY_ADDR(name);
+  if(fd < 3 || fd >= 128 || !ISDIR(fd)) return false;
+  // The directory's position lives in the file's, between calls
+  struct file *f = thread_current()->FD[fd];
+  struct dir *dir = dir_open(inode_reopen(file_get_inode(f)));
+  if (!dir) return false;
+  dir_seek(dir, file_tell(f));
+  bool res = dir_readdir(dir, name);
+  file_seek(f, dir_tell(dir));
+  dir_close(dir);
+  return res;
+}
+
+bool ISDIR (int fd) {
+  if(fd < 3 || fd >= 128 || !thread_current()->FD[fd]) return false;
+  return inode_is_dir(file_get_inode(thread_current()->FD[fd]));
+}
+
+int INUMBER (int fd) {
+  if(fd < 3 || fd >= 128 || !thread_current()->FD[fd]) EXIT(-1);
+  return inode_get_inumber(file_get_inode(thread_current()->FD[fd]));
+}
 
 int FIBONACCI(int n) {
   int a = 0, b = 1, c = 0;
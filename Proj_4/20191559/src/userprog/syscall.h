@@ -3,7 +3,6 @@
 #include "lib/user/syscall.h"
 
 typedef int pid_t;
-struct lock lock_file;
 
 void syscall_init (void);
 
@@ -22,6 +21,11 @@ void syscall_init (void);
  * SEEK: 2
  * TELL: 1
  * CLOSE: 1
+ * CHDIR: 1
+ * MKDIR: 1
+ * READDIR: 2
+ * ISDIR: 1
+ * INUMBER: 1
 */
 void HALT (void);
 void EXIT (int status);
@@ -36,6 +40,11 @@ int WRITE (int fd, const void *buffer, unsigned size);
 void SEEK (int fd, unsigned pos);
 unsigned TELL (int fd);
 void CLOSE (int fd);
+bool CHDIR (const char *dir);
+bool MKDIR (const char *dir);
+bool READDIR (int fd, char *name);
+bool ISDIR (int fd);
+int INUMBER (int fd);
 
 int FIBONACCI(int n);
 int MAX_OF_FOUR_INT(int a, int b, int c, int d);
@@ -10,6 +10,7 @@
 
 #include "vm/frame.h"
 #include "vm/swap.h"
+#include "vm/ksm.h"
 
 #define FOR(i, n) for(int i=0; i<n; i++)
 #define FOR1(i, n) for(int i=1; i<=n; i++)
@@ -17,6 +18,7 @@
 #define FOR_LIST(e, list) \
     for ((e) = list_begin(list); (e) != list_end(list); (e) = list_next(e))
 
+struct slab_cache *page_cache;
 
 void *try_alloc_physical_memory(enum palloc_flags flags) {
   void *page_kernel_addr;
@@ -30,7 +32,7 @@ void *try_alloc_physical_memory(enum palloc_flags flags) {
 struct page *page_allocation(enum palloc_flags flags) {
   if (flags & PAL_USER) {
     void *page_kernel_addr = try_alloc_physical_memory(flags);
-    struct page *page_new_addr = malloc(sizeof(struct page));
+    struct page *page_new_addr = slab_alloc(page_cache);
 
     if (!page_new_addr) {
         palloc_free_page(page_kernel_addr);
@@ -38,6 +40,9 @@ struct page *page_allocation(enum palloc_flags flags) {
     }  
     page_new_addr->kernel_addr = page_kernel_addr;
     page_new_addr->owner_thread = thread_current();
+    page_new_addr->vme = NULL;
+    page_new_addr->ksm_checksum = 0;
+    page_new_addr->ksm_unstable = false;
     page_emplace_LRU(page_new_addr);
     
     return page_new_addr;
@@ -85,8 +90,9 @@ void free_and_remove_page (void *page_kernel_addr) {
   	struct page* lru_page = list_entry(e, struct page, lru);
   	if(page_kernel_addr == lru_page->kernel_addr){
   	  palloc_free_page(lru_page->kernel_addr);
+  	  ksm_forget_page(lru_page);
   	  page_out_LRU(lru_page);
-  	  free(lru_page);
+  	  slab_free(page_cache, lru_page);
   	  break;
   	}
   }
@@ -138,8 +144,9 @@ void evict_pages_from_lru() {
       lru_page->vme->is_in_memory = false;
       pagedir_clear_page(page_thread->pagedir, lru_page->vme->vaddr);
 	    palloc_free_page(lru_page->kernel_addr);
+	    ksm_forget_page(lru_page);
 	    page_out_LRU(lru_page);
-	    free(lru_page);  
+	    slab_free(page_cache, lru_page);  
       break;
     }  
     pagedir_set_accessed(page_thread->pagedir, lru_page->vme->vaddr, false);
@@ -152,4 +159,6 @@ void init_LRU () {
   list_init(&lru_list);
   lock_init(&lru_lock);
   lru_clock = NULL;
+  page_cache = slab_cache_create("page", sizeof(struct page), NULL);
+  vme_cache = slab_cache_create("vm_entry", sizeof(struct virtual_page_entr), NULL);
 }
\ No newline at end of file
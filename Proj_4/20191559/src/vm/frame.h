@@ -1,8 +1,11 @@
 #ifndef FILE_H
 #define FILE_H
 #include <threads/palloc.h>
+#include <threads/slab.h>
 #include "page.h"
 
+extern struct slab_cache *page_cache;                   // Cache of struct page
+
 struct page* page_allocation(enum palloc_flags flags);  // Allocate a page of memory to be used as a user page
 
 bool page_emplace_LRU(struct page *new_page);           // Add a page to the LRU list
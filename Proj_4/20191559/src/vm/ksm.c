@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <string.h>
+#include <hash.h>
+#include <list.h>
+#include "userprog/pagedir.h"
+#include "threads/interrupt.h"
+#include <threads/malloc.h>
+#include <threads/palloc.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#include "vm/frame.h"
+#include "vm/ksm.h"
+
+/* Kernel same-page merging.
+
+   A low-priority kernel thread walks the frame list (lru_list)
+   a few pages at a time and hashes the contents of every
+   resident anonymous page, i.e. a stack page or a page that came
+   back from swap.  A page whose checksum did not change since the
+   previous pass is a merge candidate:
+
+     - If an identical frame is already shared (the "stable"
+       table), the page is remapped read-only onto it and its own
+       frame is freed.
+
+     - Otherwise, if another candidate seen during this pass has
+       the same contents (the "unstable" table), that candidate's
+       frame is turned into a new shared frame and both pages are
+       mapped onto it.
+
+   Shared frames leave the frame list, so they are never evicted;
+   they go away when the last page mapping them is unmapped or
+   takes a private copy on a write fault (ksm_break_cow()).
+
+   The final compare and remap runs with interrupts off, so on
+   our uniprocessor no write can slip in between them. */
+
+#define UNSTABLE_BUCKETS 64
+
+bool ksm_enabled;
+size_t ksm_pages_to_scan = KSM_DEFAULT_PAGES;
+
+static struct hash stable_table;                        // Shared frames, by contents.
+static struct list unstable_table[UNSTABLE_BUCKETS];    // Candidates seen this pass.
+static struct lock ksm_lock;                            // Protects stable_table, ref_cnt.
+static struct page *ksm_cursor;                         // Next page to scan, NULL: start over.
+
+static long long pages_scanned;                         // Candidate pages hashed.
+static long long pages_merged;                          // Pages mapped onto a shared frame.
+static long long cow_breaks;                            // Write faults on a shared frame.
+
+static unsigned hash_ksm_frame(const struct hash_elem *e, void *aux UNUSED) {
+  return hash_entry(e, struct ksm_frame, elem)->checksum;
+}
+
+static bool smaller_ksm_frame(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+  const struct ksm_frame *a = hash_entry(a_, struct ksm_frame, elem);
+  const struct ksm_frame *b = hash_entry(b_, struct ksm_frame, elem);
+  if (a->checksum != b->checksum) return a->checksum < b->checksum;
+  return memcmp(a->kernel_addr, b->kernel_addr, PGSIZE) < 0;
+}
+
+static bool is_anonymous(struct page *page) {
+  struct virtual_page_entr *vme = page->vme;
+  return vme != NULL && (vme->backing_file == NULL || vme->type);
+}
+
+static void clear_unstable_table(void) {
+  for (int i = 0; i < UNSTABLE_BUCKETS; i++) {
+    while (!list_empty(&unstable_table[i])) {
+      struct page *p = list_entry(list_pop_front(&unstable_table[i]), struct page, ksm_elem);
+      p->ksm_unstable = false;
+    }
+  }
+}
+
+// Finds a candidate other than PAGE with the same contents, or NULL.
+static struct page *find_unstable(struct page *page) {
+  struct list *bucket = &unstable_table[page->ksm_checksum % UNSTABLE_BUCKETS];
+  struct list_elem *e;
+
+  for (e = list_begin(bucket); e != list_end(bucket); e = list_next(e)) {
+    struct page *p = list_entry(e, struct page, ksm_elem);
+    if (p != page && p->ksm_checksum == page->ksm_checksum
+        && !memcmp(p->kernel_addr, page->kernel_addr, PGSIZE))
+      return p;
+  }
+  return NULL;
+}
+
+// Points PAGE's user mapping at shared frame KF.  Interrupts off.
+static void remap_shared(struct page *page, struct ksm_frame *kf) {
+  uint32_t *pd = page->owner_thread->pagedir;
+  void *upage = page->vme->vaddr;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  pagedir_clear_page(pd, upage);
+  pagedir_set_page(pd, upage, kf->kernel_addr, false);
+  page->vme->ksm_frame = kf;
+  page_out_LRU(page);
+}
+
+// Merges PAGE into the shared frame KF if their contents still match.
+static bool merge_stable(struct page *page, struct ksm_frame *kf) {
+  enum intr_level old_level = intr_disable();
+  bool same = !memcmp(page->kernel_addr, kf->kernel_addr, PGSIZE);
+  if (same) {
+    remap_shared(page, kf);
+    kf->ref_cnt++;
+  }
+  intr_set_level(old_level);
+  return same;
+}
+
+// Turns OTHER's frame into a new shared frame and merges PAGE into it.
+static bool merge_unstable(struct page *page, struct page *other) {
+  struct ksm_frame *kf = malloc(sizeof *kf);
+  if (!kf) return false;
+
+  kf->kernel_addr = other->kernel_addr;
+  kf->checksum = other->ksm_checksum;
+  kf->ref_cnt = 2;
+
+  enum intr_level old_level = intr_disable();
+  bool same = !memcmp(page->kernel_addr, other->kernel_addr, PGSIZE);
+  if (same) {
+    ksm_forget_page(other);
+    remap_shared(other, kf);
+    remap_shared(page, kf);
+  }
+  intr_set_level(old_level);
+
+  if (!same) {
+    free(kf);
+    return false;
+  }
+  // Both mappings are read-only now, so the contents are frozen.
+  hash_insert(&stable_table, &kf->elem);
+  slab_free(page_cache, other);
+  return true;
+}
+
+// Looks at one page of the frame list.  lru_lock and ksm_lock held.
+static void scan_page(struct page *page) {
+  struct thread *t = page->owner_thread;
+
+  if (!is_anonymous(page) || t->vm_exiting || t->pagedir == NULL) return;
+  if (pagedir_get_page(t->pagedir, page->vme->vaddr) != page->kernel_addr) return;
+
+  pages_scanned++;
+  unsigned checksum = hash_bytes(page->kernel_addr, PGSIZE);
+  if (checksum != page->ksm_checksum) {
+    // Changed since the last pass; too volatile to share.
+    ksm_forget_page(page);
+    page->ksm_checksum = checksum;
+    return;
+  }
+
+  struct ksm_frame probe;
+  probe.kernel_addr = page->kernel_addr;
+  probe.checksum = checksum;
+  struct hash_elem *found = hash_find(&stable_table, &probe.elem);
+  bool merged = false;
+
+  if (found) {
+    merged = merge_stable(page, hash_entry(found, struct ksm_frame, elem));
+  } else {
+    struct page *other = find_unstable(page);
+    if (other) merged = merge_unstable(page, other);
+  }
+
+  if (merged) {
+    ksm_forget_page(page);
+    palloc_free_page(page->kernel_addr);
+    slab_free(page_cache, page);
+    pages_merged++;
+  } else if (!page->ksm_unstable) {
+    list_push_back(&unstable_table[checksum % UNSTABLE_BUCKETS], &page->ksm_elem);
+    page->ksm_unstable = true;
+  }
+}
+
+// Scans up to BUDGET pages, continuing where the last call stopped.
+static void ksm_scan(size_t budget) {
+  lock_acquire(&lru_lock);
+  lock_acquire(&ksm_lock);
+
+  struct list_elem *e = ksm_cursor ? &ksm_cursor->lru : list_begin(&lru_list);
+  while (budget-- > 0 && e != list_end(&lru_list)) {
+    struct page *page = list_entry(e, struct page, lru);
+    struct list_elem *next = list_next(e);
+
+    // Park the cursor on the next page first: merging may take
+    // that page off the list, and ksm_forget_page() moves it on.
+    ksm_cursor = next != list_end(&lru_list) ? list_entry(next, struct page, lru) : NULL;
+    scan_page(page);
+    e = ksm_cursor ? &ksm_cursor->lru : list_end(&lru_list);
+  }
+  if (e == list_end(&lru_list)) {
+    // End of a full pass: candidates must be seen again.
+    clear_unstable_table();
+    ksm_cursor = NULL;
+  }
+
+  lock_release(&ksm_lock);
+  lock_release(&lru_lock);
+}
+
+static void ksm_daemon(void *aux UNUSED) {
+  for (;;) {
+    timer_sleep(KSM_SLEEP_TICKS);
+    ksm_scan(ksm_pages_to_scan);
+  }
+}
+
+void ksm_init(void) {
+  hash_init(&stable_table, hash_ksm_frame, smaller_ksm_frame, NULL);
+  for (int i = 0; i < UNSTABLE_BUCKETS; i++) list_init(&unstable_table[i]);
+  lock_init(&ksm_lock);
+  ksm_cursor = NULL;
+
+  if (ksm_enabled) thread_create("ksmd", PRI_MIN, ksm_daemon, NULL);
+}
+
+void ksm_forget_page(struct page *page) {
+  ASSERT(lock_held_by_current_thread(&lru_lock));
+
+  if (page == ksm_cursor) {
+    struct list_elem *next = list_next(&page->lru);
+    ksm_cursor = next != list_end(&lru_list) ? list_entry(next, struct page, lru) : NULL;
+  }
+  if (page->ksm_unstable) {
+    list_remove(&page->ksm_elem);
+    page->ksm_unstable = false;
+  }
+}
+
+// Drops one reference to KF, freeing the frame with the last one.
+static void ksm_put(struct ksm_frame *kf) {
+  lock_acquire(&ksm_lock);
+  if (--kf->ref_cnt == 0) {
+    hash_delete(&stable_table, &kf->elem);
+    palloc_free_page(kf->kernel_addr);
+    free(kf);
+  }
+  lock_release(&ksm_lock);
+}
+
+bool ksm_break_cow(struct virtual_page_entr *vme) {
+  struct ksm_frame *kf = vme->ksm_frame;
+  if (!kf || !vme->is_writable) return false;
+
+  struct page *page = page_allocation(PAL_USER);
+  if (!page) return false;
+  memcpy(page->kernel_addr, kf->kernel_addr, PGSIZE);
+  page->vme = vme;
+
+  uint32_t *pd = thread_current()->pagedir;
+  pagedir_clear_page(pd, vme->vaddr);
+  vme->ksm_frame = NULL;
+  if (!pagedir_set_page(pd, vme->vaddr, page->kernel_addr, true)) {
+    free_and_remove_page(page->kernel_addr);
+    vme->ksm_frame = kf;
+    pagedir_set_page(pd, vme->vaddr, kf->kernel_addr, false);
+    return false;
+  }
+
+  ksm_put(kf);
+  cow_breaks++;
+  return true;
+}
+
+void ksm_unmap(struct virtual_page_entr *vme) {
+  struct ksm_frame *kf = vme->ksm_frame;
+  if (!kf) return;
+
+  pagedir_clear_page(thread_current()->pagedir, vme->vaddr);
+  vme->ksm_frame = NULL;
+  ksm_put(kf);
+}
+
+void ksm_print_stats(void) {
+  if (!ksm_enabled) return;
+  printf("KSM: %lld pages scanned, %lld pages merged, %lld CoW breaks\n",
+         pages_scanned, pages_merged, cow_breaks);
+}
@@ -0,0 +1,28 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <hash.h>
+#include "vm/page.h"
+
+#define KSM_DEFAULT_PAGES 64          // Default scan budget: pages per pass
+#define KSM_SLEEP_TICKS 10            // Ticks the scanner sleeps between passes
+
+// A read-only frame shared by every page whose contents were found identical.
+struct ksm_frame {
+  void *kernel_addr;                  // Kernel virtual address of the shared frame.
+  unsigned checksum;                  // hash_bytes() of the frame contents.
+  int ref_cnt;                        // Number of virtual pages mapping this frame.
+  struct hash_elem elem;              // Element in the stable table.
+};
+
+extern bool ksm_enabled;              // Set by kernel option "-ksm".
+extern size_t ksm_pages_to_scan;      // Scan budget, "-ksm=PAGES".
+
+void ksm_init(void);                                      // Start the scanner thread if enabled
+void ksm_forget_page(struct page *page);                  // Drop PAGE from the scanner state, lru_lock held
+bool ksm_break_cow(struct virtual_page_entr *vme);        // Give VME a private copy of its shared frame
+void ksm_unmap(struct virtual_page_entr *vme);            // Drop VME's reference on its shared frame
+void ksm_print_stats(void);                               // Print scanner counters
+
+#endif
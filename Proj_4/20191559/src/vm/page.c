@@ -16,6 +16,8 @@
 #include "vm/page.h"
 #include "vm/frame.h"
 
+struct slab_cache *vme_cache;
+
 struct virtual_page_entr *get_virtual_page_entr_by_vaddr(void *virtual_address) {
   struct virtual_page_entr search_entry;
   search_entry.vaddr = pg_round_down(virtual_address);
@@ -38,6 +40,6 @@ bool add_virtual_page_entr(struct hash *vm_table, struct virtual_page_entr *virt
 
 bool remove_virtual_page_entr(struct hash *vm_table, struct virtual_page_entr *virtual_page_entr) {
   bool is_removed = hash_delete(vm_table, &virtual_page_entr->elem) != NULL;
-  free(virtual_page_entr);
+  slab_free(vme_cache, virtual_page_entr);
   return is_removed;
 }
\ No newline at end of file
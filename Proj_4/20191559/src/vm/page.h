@@ -1,6 +1,9 @@
 #ifndef VM_PAGE_H
 #define VM_PAGE_H
 #include <hash.h>
+#include <threads/slab.h>
+
+struct ksm_frame;
 
 // Virtual memory entry structure representing a page in the process's virtual address space.
 struct virtual_page_entr {
@@ -18,8 +21,11 @@ struct virtual_page_entr {
   void *vaddr;                 // Virtual address mapped by this entry.
   struct hash_elem elem;  		 // Hash table element for thread's VM hash table.
 	struct file *backing_file;   // File backing this VM entry, if any.
+  struct ksm_frame *ksm_frame; // Shared read-only frame if merged by KSM, else NULL.
 };
 
+extern struct slab_cache *vme_cache;                                                                // Cache of struct virtual_page_entr
+
 struct virtual_page_entr *get_virtual_page_entr_by_vaddr(void *virtual_address);						        // Get a VM entry by its virtual address.
 bool read_file_into_memory(void *kernel_addr, struct virtual_page_entr *virtual_page_entr);	        // Read a file into memory.
 bool add_virtual_page_entr(struct hash *vm_table, struct virtual_page_entr *virtual_page_entr);		  // Add a VM entry to the VM hash table.
@@ -34,6 +40,10 @@ struct page {
 	void* kernel_addr;						    // Kernel virtual address of the page.
 	struct virtual_page_entr *vme;		// VM entry corresponding to the page.
 
+  unsigned ksm_checksum;            // Contents hash seen by the last KSM pass.
+  bool ksm_unstable;                // True if in the KSM unstable table.
+  struct list_elem ksm_elem;        // Element in the KSM unstable table.
+
 };
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include "bitmap.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "devices/block.h"
 
 #include "vm/frame.h"
@@ -15,48 +16,168 @@
 #define FOR_LIST(e, list) \
     for ((e) = list_begin(list); (e) != list_end(list); (e) = list_next(e))
 
-struct block *block_swp;
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Swap may span several block devices.  A swap index is global:
+   device D owns indexes [D->base, D->base + D->slot_cnt).
+
+   Devices are kept sorted by descending priority.  Slots are
+   handed out round-robin across the devices of the highest
+   priority that still has room, so consecutive page-outs go to
+   different disks (and, on separate IDE channels, overlap).  A
+   lower-priority device only receives overflow. */
+struct swap_device {
+  struct block *block;          // Backing block device.
+  int priority;                 // Higher is preferred.
+  size_t base;                  // First global swap index on this device.
+  size_t slot_cnt;              // Number of page-sized slots.
+  struct bitmap *map;           // Slot in use?
+  size_t rotor;                 // Next device to try, kept in a group's first device.
+};
+
+static struct swap_device swap_devices[SWAP_MAX_DEVICES];
+static int swap_device_cnt;
+static size_t swap_slot_cnt;    // Total slots over all devices.
+
+struct lock lock_swp;           // Protects the slot maps, not the I/O.
+
+// Returns the device holding global SWAP_INDEX.
+static struct swap_device *index_to_device(size_t swap_index) {
+  FOR(i, swap_device_cnt) {
+    struct swap_device *d = &swap_devices[i];
+    if (swap_index >= d->base && swap_index < d->base + d->slot_cnt) return d;
+  }
+  return NULL;
+}
+
 void handle_block_io(bool is_read, size_t swap_index, void *physical_addr) {
-  FOR(i, 8) {
-    size_t sector_idx = swap_index * 8 + i;
+  struct swap_device *d = index_to_device(swap_index);
+  ASSERT(d != NULL);
+
+  FOR(i, SECTORS_PER_SLOT) {
+    size_t sector_idx = (swap_index - d->base) * SECTORS_PER_SLOT + i;
     uint8_t *sector_addr = (uint8_t *)physical_addr + i * BLOCK_SECTOR_SIZE;
-    if (is_read) block_read(block_swp, sector_idx, sector_addr);
-    else block_write(block_swp, sector_idx, sector_addr);
+    if (is_read) block_read(d->block, sector_idx, sector_addr);
+    else block_write(d->block, sector_idx, sector_addr);
   }
 }
 
-struct lock lock_swp;
-struct bitmap *map;
+// Claims a free slot, striping across the best priority group.
+static size_t allocate_slot(void) {
+  int i = 0;
+  while (i < swap_device_cnt) {
+    struct swap_device *head = &swap_devices[i];
+    int j = i;
+    while (j < swap_device_cnt && swap_devices[j].priority == head->priority) j++;
+
+    int n = j - i;
+    FOR(k, n) {
+      int pick = (head->rotor + k) % n;
+      struct swap_device *d = &swap_devices[i + pick];
+      size_t slot = bitmap_scan_and_flip(d->map, 0, 1, false);
+      if (slot != BITMAP_ERROR) {
+        head->rotor = (pick + 1) % n;
+        return d->base + slot;
+      }
+    }
+    i = j;
+  }
+  return BITMAP_ERROR;
+}
+
 void read_from_swap(size_t swap_index, void *physical_addr) {
+  struct swap_device *d = index_to_device(swap_index);
+  if (!d) return;
+
   lock_acquire(&lock_swp);
-  
-  if (bitmap_test(map, swap_index)) {
-      handle_block_io(true, swap_index, physical_addr);
-      bitmap_flip(map, swap_index);
-  }
-  
+  bool in_use = bitmap_test(d->map, swap_index - d->base);
+  lock_release(&lock_swp);
+  if (!in_use) return;
+
+  // The slot is ours until we free it, so the transfer runs
+  // unlocked and can overlap with I/O on other devices.
+  handle_block_io(true, swap_index, physical_addr);
+
+  lock_acquire(&lock_swp);
+  bitmap_reset(d->map, swap_index - d->base);
   lock_release(&lock_swp);
 }
 
 size_t write_to_swap(void *physical_addr) {
   lock_acquire(&lock_swp);
+  size_t swap_index = allocate_slot();
+  lock_release(&lock_swp);
 
-  size_t swap_index = bitmap_scan_and_flip(map, 0, 1, false);
   if (swap_index != BITMAP_ERROR) handle_block_io(false, swap_index, physical_addr);
-  
-  lock_release(&lock_swp);
-  
   return swap_index;
 }
 
-void initialize_swap() {
-  block_swp = block_get_role(BLOCK_SWAP);
-  if (!block_swp) return;
+// Adds BLOCK to the swap device table, keeping it sorted by priority.
+static void add_swap_device(struct block *block, int priority) {
+  if (swap_device_cnt >= SWAP_MAX_DEVICES)
+    PANIC("too many swap devices (at most %d)", SWAP_MAX_DEVICES);
+
+  FOR(i, swap_device_cnt)
+    if (swap_devices[i].block == block) PANIC("swap device %s given twice", block_name(block));
+
+  size_t slot_cnt = block_size(block) / SECTORS_PER_SLOT;
+  struct bitmap *map = bitmap_create(slot_cnt);
+  if (!map) PANIC("swap map creation failed for %s", block_name(block));
+  bitmap_enable_hint(map);      // Every map access holds lock_swp.
+
+  int pos = swap_device_cnt;
+  while (pos > 0 && swap_devices[pos - 1].priority < priority) {
+    swap_devices[pos] = swap_devices[pos - 1];
+    pos--;
+  }
+
+  struct swap_device *d = &swap_devices[pos];
+  d->block = block;
+  d->priority = priority;
+  d->slot_cnt = slot_cnt;
+  d->map = map;
+  d->rotor = 0;
+  swap_device_cnt++;
+}
+
+// Parses SPEC, a comma-separated list of BDEV[:PRIORITY].
+static void parse_swap_spec(const char *spec) {
+  static char buf[128];
+  char *save_ptr, *dev;
 
-  size_t swap_size = block_size(block_swp) / 8;
-  map = bitmap_create(swap_size);
-  if (!map) return;
+  strlcpy(buf, spec, sizeof buf);
+  for (dev = strtok_r(buf, ",", &save_ptr); dev != NULL; dev = strtok_r(NULL, ",", &save_ptr)) {
+    char *colon = strchr(dev, ':');
+    int priority = 0;
+    if (colon) {
+      *colon = '\0';
+      priority = atoi(colon + 1);
+    }
 
-  bitmap_set_all(map, 0);
+    struct block *block = block_get_by_name(dev);
+    if (!block) PANIC("No such block device \"%s\"", dev);
+    add_swap_device(block, priority);
+  }
+}
+
+void initialize_swap(const char *spec) {
   lock_init(&lock_swp);
-}
\ No newline at end of file
+
+  if (spec) {
+    parse_swap_spec(spec);
+  } else {
+    // No -swap option: every swap-typed device, all at equal priority.
+    struct block *block;
+    for (block = block_first(); block != NULL; block = block_next(block))
+      if (block_type(block) == BLOCK_SWAP) add_swap_device(block, 0);
+  }
+
+  swap_slot_cnt = 0;
+  FOR(i, swap_device_cnt) {
+    struct swap_device *d = &swap_devices[i];
+    d->base = swap_slot_cnt;
+    swap_slot_cnt += d->slot_cnt;
+    printf("swap: using %s (priority %d, %zu slots)\n", block_name(d->block), d->priority, d->slot_cnt);
+  }
+  if (swap_device_cnt > 0) block_set_role(BLOCK_SWAP, swap_devices[0].block);
+}
@@ -1,9 +1,10 @@
 #ifndef SWAP_H
 #define SWAP_H
 
+#define SWAP_MAX_DEVICES 4                                                  // Devices swap may span
+
 void handle_block_io(bool is_read, size_t swap_index, void *physical_addr); // handle block io
-void initialize_swap();                                                     // initialize swap table
-void iterate_swap(size_t swap_index, void *aux, bool rw);                   // iterate swap table
+void initialize_swap(const char *spec);                                     // initialize swap devices from "-swap" SPEC, or NULL
 void read_from_swap(size_t swap_index, void *physical_addr) ;               // read from swap table
 size_t write_to_swap(void *physical_addr);                                  // write to swap table
 